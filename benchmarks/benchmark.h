@@ -0,0 +1,150 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARKS_BENCHMARK_H
+#define BENCHMARKS_BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct BenchmarkResult {
+  std::string name;
+  size_t threads            = 1;
+  size_t iterations         = 0;  // Operations over all threads
+  double ns_per_op          = 0.0;
+  double ops_per_sec        = 0.0;
+  double p50_ns             = 0.0;  // Latency of a single operation
+  double p99_ns             = 0.0;
+  double p999_ns            = 0.0;
+  double allocations_per_op = 0.0;
+  bool allocation_free      = false;  // Fails the run if anything allocated
+  bool failed               = false;  // Set by benchmarks that check results
+};
+
+// Upper bound on the operations timed one by one for the percentiles
+static constexpr size_t s_BenchmarkLatencySamples = 200'000;
+
+// Incremented by the global operator new of the benchmark executable
+extern std::atomic<size_t> g_benchmark_allocations;
+
+// Written to by benchmarks so the measured work cannot be optimized out
+inline volatile size_t g_benchmark_sink = 0;
+
+// Sorts the samples and fills in the percentiles
+void benchmark_percentiles(BenchmarkResult& result,
+                           std::vector<double>& samples);
+
+// Runs func(i) iterations times for the throughput, then times up to
+// s_BenchmarkLatencySamples more calls one by one for the percentiles
+template <typename TFunc>
+BenchmarkResult run_benchmark(std::string_view name, size_t iterations,
+                              TFunc&& func) {
+  using Clock = std::chrono::steady_clock;
+  std::vector<double> samples(
+      std::min(iterations, s_BenchmarkLatencySamples));
+
+  size_t allocations = g_benchmark_allocations.load();
+  auto start         = Clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    func(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  allocations = g_benchmark_allocations.load() - allocations;
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    auto op_start = Clock::now();
+    func(iterations + i);
+    samples[i] =
+        std::chrono::duration<double, std::nano>(Clock::now() - op_start)
+            .count();
+  }
+
+  BenchmarkResult result {
+      .name               = std::string(name),
+      .iterations         = iterations,
+      .ns_per_op          = elapsed.count() / (double)iterations,
+      .ops_per_sec        = (double)iterations * 1e9 / elapsed.count(),
+      .allocations_per_op = (double)allocations / (double)iterations,
+  };
+  benchmark_percentiles(result, samples);
+  return result;
+}
+
+// Runs func(thread, i) iterations times on each of threads threads at once.
+// Calls spread evenly over the run are timed for the percentiles
+template <typename TFunc>
+BenchmarkResult run_threaded_benchmark(std::string_view name, size_t threads,
+                                       size_t iterations, TFunc&& func) {
+  using Clock = std::chrono::steady_clock;
+  size_t sampled = std::min(iterations, s_BenchmarkLatencySamples / threads);
+  std::vector<std::vector<double>> samples(threads,
+                                           std::vector<double>(sampled));
+  std::vector<std::thread> workers;
+  std::atomic<size_t> ready = 0;
+
+  auto start = Clock::now();
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      // Start together so every thread runs under contention
+      ready.fetch_add(1);
+      while (ready.load() < threads) {
+        std::this_thread::yield();
+      }
+      std::vector<double>& thread_samples = samples[t];
+      size_t stride                       = iterations / sampled;
+      for (size_t i = 0; i < iterations; i++) {
+        if (i % stride != 0 || i / stride >= sampled) {
+          func(t, i);
+          continue;
+        }
+        auto op_start = Clock::now();
+        func(t, i);
+        thread_samples[i / stride] =
+            std::chrono::duration<double, std::nano>(Clock::now() - op_start)
+                .count();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+  std::vector<double> merged;
+  merged.reserve(threads * sampled);
+  for (const std::vector<double>& thread_samples : samples) {
+    merged.insert(merged.end(), thread_samples.begin(), thread_samples.end());
+  }
+
+  size_t total = threads * iterations;
+  BenchmarkResult result {
+      .name        = std::string(name),
+      .threads     = threads,
+      .iterations  = total,
+      .ns_per_op   = elapsed.count() / (double)total,
+      .ops_per_sec = (double)total * 1e9 / elapsed.count(),
+  };
+  benchmark_percentiles(result, merged);
+  return result;
+}
+
+void run_console_benchmarks(std::vector<BenchmarkResult>& results);
+
+#endif
@@ -0,0 +1,227 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmark.h"
+#include "core/console.h"
+#include "core/console_file.h"
+#include <charconv>
+#include <filesystem>
+#include <thread>
+
+static constexpr size_t s_Iterations          = 50'000'000;
+static constexpr size_t s_FormattedIterations = 1'000'000;
+static constexpr size_t s_TerminalIterations  = 100'000;
+static constexpr size_t s_SinkThreads         = 4;
+static constexpr size_t s_StressThreads       = 8;
+static constexpr size_t s_StressMessages      = 100'000;
+static constexpr size_t s_StressOutputChanges = 1'000;
+
+// Formats every message like a terminal output would but drops the text, so
+// only the cost of the console itself is measured
+class NullOutput : public ConsoleOutput {
+public:
+  NullOutput(int opts)
+        : ConsoleOutput(opts) {}
+
+  inline std::string_view name() const override { return "Null Output"; }
+  void print_output(const ConsoleMessage& msg) override { _format(msg); }
+};
+
+// Checks that the "stress <thread> <index>" messages of every thread arrive
+// in the order they were printed. A slot is only touched by the thread that
+// printed into it, or by the async writer
+class OrderedOutput : public ConsoleOutput {
+public:
+  OrderedOutput(int opts)
+        : ConsoleOutput(opts), _next(s_StressThreads, 0) {}
+
+  inline std::string_view name() const override { return "Ordered Output"; }
+  void print_output(const ConsoleMessage& msg) override {
+    size_t thread = 0, index = 0;
+    const char* end = msg.msg.data() + msg.msg.size();
+    const char* ptr = msg.msg.data() + std::string_view("stress ").size();
+    ptr             = std::from_chars(ptr, end, thread).ptr + 1;
+    std::from_chars(ptr, end, index);
+
+    if (thread >= _next.size() || _next[thread] != index) {
+      ordered.store(false, std::memory_order_relaxed);
+      return;
+    }
+    _next[thread]++;
+    received.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<size_t> received = 0;
+  std::atomic<bool> ordered    = true;
+
+private:
+  std::vector<size_t> _next;
+};
+
+// Many threads print while outputs are added and removed, meant to be run
+// with FIWRE_ENABLE_TSAN as well
+static BenchmarkResult run_console_stress(std::string_view name,
+                                          int console_opts) {
+  Console console(console_opts);
+  OrderedOutput* ordered = console.add_output<OrderedOutput>(
+      ConsoleOutput::s_DefaultOptions | ConsoleOutput_SeverityInfoBit);
+
+  std::atomic<size_t> printing = s_StressThreads;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < s_StressThreads; t++) {
+    threads.emplace_back([t, &printing]() {
+      for (size_t i = 0; i < s_StressMessages; i++) {
+        INFO("stress {} {}", t, i);
+      }
+      printing.fetch_sub(1);
+    });
+  }
+  for (size_t i = 0; i < s_StressOutputChanges && printing.load() > 0; i++) {
+    NullOutput* output = console.add_output<NullOutput>(
+        ConsoleOutput::s_DefaultOptions | ConsoleOutput_SeverityInfoBit);
+    std::this_thread::yield();
+    console.remove_output(output);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  console.flush();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t total = s_StressThreads * s_StressMessages;
+  BenchmarkResult result {
+      .name        = std::string(name),
+      .threads     = s_StressThreads,
+      .iterations  = total,
+      .ns_per_op   = elapsed.count() / (double)total,
+      .ops_per_sec = (double)total * 1e9 / elapsed.count(),
+      .failed      = !ordered->ordered.load() || ordered->received != total,
+  };
+  console.destroy();
+  return result;
+}
+
+// Info messages through a single sink, from one thread and from several
+static void run_sink_benchmarks(std::vector<BenchmarkResult>& results,
+                                std::string_view name, ConsoleOutput* output,
+                                int console_opts, size_t iterations) {
+  Console console(console_opts);
+  console.add_output(output);
+  INFO("warm up {} {:.2f} {}", 0, 0.0, "message");
+  console.flush();
+
+  results.push_back(run_benchmark(
+      fmt::format("console/{}/info", name), iterations, [](size_t i) {
+        INFO("enabled {} {:.2f} {}", i, (double)i * 0.5, "message");
+      }));
+  console.flush();
+
+  results.push_back(run_threaded_benchmark(
+      fmt::format("console/{}/info_mt{}", name, s_SinkThreads), s_SinkThreads,
+      iterations / s_SinkThreads, [](size_t thread, size_t i) {
+        INFO("thread {} enabled {} {:.2f}", thread, i, (double)i * 0.5);
+      }));
+  console.destroy();
+}
+
+void run_console_benchmarks(std::vector<BenchmarkResult>& results) {
+  Console console;
+  NullOutput* output = console.add_output<NullOutput>(
+      ConsoleOutput::s_DefaultOptions | ConsoleOutput::s_DefaultSeverity |
+      ConsoleOutput_SeverityInfoBit);
+
+  results.push_back(run_benchmark("baseline/empty_loop", s_Iterations,
+                                  [](size_t i) { g_benchmark_sink = i; }));
+
+  // Nothing subscribes to Trace, so all that should remain of the call is
+  // the severity mask test
+  results.push_back(
+      run_benchmark("console/disabled_trace", s_Iterations, [](size_t i) {
+        TRACE("disabled {} {}", i, "message");
+        g_benchmark_sink = i;
+      }));
+
+  // Subscribed, but the call site filters everything after the first print
+  results.push_back(
+      run_benchmark("console/filtered_info_once", s_Iterations, [](size_t i) {
+        INFO_ONCE("filtered {} {}", i, "message");
+        g_benchmark_sink = i;
+      }));
+
+  // Warm up the thread local buffers, after that a message must not touch
+  // the heap
+  INFO("warm up {} {:.2f}", 0, 0.0);
+  BenchmarkResult info = run_benchmark(
+      "console/enabled_info", s_FormattedIterations, [](size_t i) {
+        INFO("enabled {} {:.2f} {}", i, (double)i * 0.5, "message");
+      });
+  info.allocation_free = true;
+  results.push_back(info);
+
+  BenchmarkResult error = run_benchmark(
+      "console/enabled_context_error", s_FormattedIterations, [](size_t i) {
+        CONTEXT_ERROR("BENCH", "enabled {} {}", i, "message");
+      });
+  error.allocation_free = true;
+  results.push_back(error);
+
+  // Past the first message of the window only the rate limit check remains
+  output->set_rate_limit(1);
+  auto limited_info = [](size_t i) {
+    INFO("limited {} {}", i, "message");
+    g_benchmark_sink = i;
+  };
+  // The console keeps the last text of a limited call site for the summary
+  // when its window ends, warm it up with the widest text the run prints
+  limited_info(SIZE_MAX);
+  BenchmarkResult limited =
+      run_benchmark("console/rate_limited_info", s_Iterations, limited_info);
+  limited.allocation_free = true;
+  results.push_back(limited);
+
+  console.destroy();
+
+  int opts = ConsoleOutput::s_DefaultOptions |
+             ConsoleOutput::s_DefaultSeverity | ConsoleOutput_SeverityInfoBit;
+  int file_opts = ConsoleFileOutput::s_DefaultOptions |
+                  ConsoleOutput_SeverityInfoBit;
+  std::string file_path =
+      (std::filesystem::temp_directory_path() / "fiwre_benchmark.log")
+          .string();
+  ConsoleFileConfig file_config;
+  file_config.file_size         = 64 * 1024 * 1024;
+  file_config.max_rotated_files = 1;
+
+  run_sink_benchmarks(results, "null", new NullOutput(opts), 0,
+                      s_FormattedIterations);
+  run_sink_benchmarks(results, "null_async", new NullOutput(opts),
+                      Console_AsyncBit, s_FormattedIterations);
+  run_sink_benchmarks(results, "file",
+                      new ConsoleFileOutput(file_path, file_config, file_opts),
+                      0, s_FormattedIterations);
+  run_sink_benchmarks(results, "file_async",
+                      new ConsoleFileOutput(file_path, file_config, file_opts),
+                      Console_AsyncBit, s_FormattedIterations);
+  run_sink_benchmarks(results, "terminal", new ConsoleTerminalOutput(opts), 0,
+                      s_TerminalIterations);
+  std::error_code error_code;
+  std::filesystem::remove(file_path, error_code);
+  std::filesystem::remove(file_path + ".1", error_code);
+
+  results.push_back(run_console_stress("console/threaded_info", 0));
+  results.push_back(
+      run_console_stress("console/threaded_info_async", Console_AsyncBit));
+}
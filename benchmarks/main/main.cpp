@@ -0,0 +1,108 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmark.h"
+#include <cstring>
+#include <fmt/format.h>
+
+void benchmark_percentiles(BenchmarkResult& result,
+                           std::vector<double>& samples) {
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto at = [&samples](double percentile) {
+    size_t index = (size_t)(percentile * (double)(samples.size() - 1));
+    return samples[index];
+  };
+  result.p50_ns  = at(0.50);
+  result.p99_ns  = at(0.99);
+  result.p999_ns = at(0.999);
+}
+
+static void write_json(FILE* file,
+                       const std::vector<BenchmarkResult>& results) {
+  fmt::println(file, "{{");
+  fmt::println(file, "  \"version\": \"{}\",", FIWRE_VERSION);
+#ifdef NDEBUG
+  fmt::println(file, "  \"build\": \"release\",");
+#else
+  fmt::println(file, "  \"build\": \"debug\",");
+#endif
+  fmt::println(file, "  \"results\": [");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+    fmt::println(file,
+                 "    {{\"name\": \"{}\", \"threads\": {}, \"iterations\": "
+                 "{}, \"ns_per_op\": {:.3f}, \"ops_per_sec\": {:.0f}, "
+                 "\"p50_ns\": {:.1f}, \"p99_ns\": {:.1f}, \"p999_ns\": "
+                 "{:.1f}, \"allocations_per_op\": {:.3f}, \"failed\": {}}}{}",
+                 result.name, result.threads, result.iterations,
+                 result.ns_per_op, result.ops_per_sec, result.p50_ns,
+                 result.p99_ns, result.p999_ns, result.allocations_per_op,
+                 result.failed, i + 1 < results.size() ? "," : "");
+  }
+  fmt::println(file, "  ]");
+  fmt::println(file, "}}");
+}
+
+// Results are printed to stderr, stdout belongs to the terminal output
+// benchmarks. Pass --json <path> for a machine readable copy
+int main(int argc, char** argv) {
+  const char* json_path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json_path = argv[++i];
+    } else {
+      fmt::println(stderr, "usage: {} [--json <path>]", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<BenchmarkResult> results;
+  run_console_benchmarks(results);
+
+  int status = 0;
+  fmt::println(stderr, "{:<36} {:>3} {:>10} {:>10} {:>9} {:>9} {:>9} {:>8}",
+               "name", "thr", "ns/op", "ops/s", "p50", "p99", "p999",
+               "allocs");
+  for (BenchmarkResult& result : results) {
+    fmt::println(stderr,
+                 "{:<36} {:>3} {:>10.3f} {:>10.3g} {:>9.1f} {:>9.1f} "
+                 "{:>9.1f} {:>8.3f}",
+                 result.name, result.threads, result.ns_per_op,
+                 result.ops_per_sec, result.p50_ns, result.p99_ns,
+                 result.p999_ns, result.allocations_per_op);
+    if (result.allocation_free && result.allocations_per_op > 0.0) {
+      fmt::println(stderr, "{} is expected to be allocation free",
+                   result.name);
+      result.failed = true;
+    }
+    if (result.failed) {
+      fmt::println(stderr, "{} failed", result.name);
+      status = 1;
+    }
+  }
+
+  if (json_path != nullptr) {
+    FILE* file = std::fopen(json_path, "w");
+    if (file == nullptr) {
+      fmt::println(stderr, "Failed to open '{}'", json_path);
+      return 1;
+    }
+    write_json(file, results);
+    std::fclose(file);
+  }
+  return status;
+}
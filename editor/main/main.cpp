@@ -14,25 +14,157 @@
 // limitations under the License.
 
 #include "core/console.h"
+#include "core/console_ring.h"
 #include "core/input.h"
+#include "gfx_rhi/frame_pacer.h"
+#include "gfx_rhi/frame_sync.h"
 #include "gfx_rhi/window_handle.h"
+#include "panels/log_panel.h"
+#include <backends/imgui_impl_glfw.h>
+#include <backends/imgui_impl_opengl3.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glad/glad.h>
+#include <imgui.h>
+#include <vector>
+
+static void _report_replay(std::vector<double>& frame_ms) {
+  if (frame_ms.empty()) {
+    return;
+  }
+  double total = 0.0;
+  for (double ms : frame_ms) {
+    total += ms;
+  }
+  std::sort(frame_ms.begin(), frame_ms.end());
+  auto percentile = [&](double p) {
+    return frame_ms[(size_t)(p * (double)(frame_ms.size() - 1))];
+  };
+  CONTEXT_INFO("EDITOR",
+               "Replayed {} frames: avg {:.3f}ms, p50 {:.3f}ms, p99 {:.3f}ms, "
+               "max {:.3f}ms",
+               frame_ms.size(), total / (double)frame_ms.size(),
+               percentile(0.5), percentile(0.99), frame_ms.back());
+}
+
+int main(int argc, char** argv) {
+  // --record <path>: Record the input of this session
+  // --replay <path>: Replay a recorded session, report the frame times and
+  //   exit once it ends
+  // --headless: Run without a display, see WindowHandle_HeadlessBit
+  // --frames <count>: Exit after this many frames
+  // --fps <rate>: Limit the frame rate, see FramePacer
+  const char* record_path = nullptr;
+  const char* replay_path = nullptr;
+  int window_flags        = WindowHandle::s_DefaultOptions;
+  uint64_t max_frames     = UINT64_MAX;
+  FramePacerConfig pacing;
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--record") == 0 && has_value) {
+      record_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--replay") == 0 && has_value) {
+      replay_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--headless") == 0) {
+      window_flags |= WindowHandle_HeadlessBit;
+    } else if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+      max_frames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--fps") == 0 && has_value) {
+      pacing.target_fps = std::strtod(argv[++i], nullptr);
+    }
+  }
 
-int main() {
   Console console;
-  console.add_output<ConsoleTerminalOutput>(
+  // Per frame messages would otherwise flood the terminal
+  ConsoleTerminalOutput* terminal = console.add_output<ConsoleTerminalOutput>(
       ConsoleOutput::s_DefaultOptions | ConsoleOutput::s_DefaultSeverity |
       ConsoleOutput_SeverityInfoBit | ConsoleOutput_SeverityVerboseBit |
-      ConsoleOutput_SeverityTraceBit);
+      ConsoleOutput_SeverityTraceBit | ConsoleOutput_CoalesceBit);
+  terminal->set_rate_limit(20);
+  ConsoleRingOutput* log_ring = new ConsoleRingOutput(
+      ConsoleRingOutput::s_DefaultOptions, 1 << 20);
+  console.add_output(log_ring);
+
+  WindowHandle window("Engine Editor", -1, -1, window_flags);
+  bool render = window.has_context();
+  FramePacer pacer(&window, pacing);
+  FramesInFlight frames(&window);
+
+  // Initialized before Input so Input is the outermost callback, it forwards
+  // replayed events to ImGui and swallows the live ones while replaying
+  ImGui::CreateContext();
+  ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+  if (render) {
+    ImGui_ImplGlfw_InitForOpenGL(window.handle_ptr(), true);
+    ImGui_ImplOpenGL3_Init("#version 450 core");
+  } else {
+    // The UI still runs without a renderer, it just never gets drawn
+    ImGui_ImplGlfw_InitForOther(window.handle_ptr(), true);
+    ImGui::GetIO().Fonts->Build();
+  }
+  LogPanel log_panel(log_ring);
 
-  WindowHandle window("Engine Editor");
   Input input(&window);
+  // Events arriving while the pacer waits get timestamped then, instead of
+  // sitting in the OS queue until the next frame
+  pacer.set_wait_callback(
+      [](void* user_data) { ((Input*)user_data)->pump_events(); }, &input);
+
+  if (replay_path != nullptr && !input.start_replay(replay_path)) {
+    replay_path = nullptr;
+  } else if (record_path != nullptr) {
+    input.start_recording(record_path);
+  }
+  std::vector<double> frame_ms;
+  auto frame_begin = std::chrono::steady_clock::now();
+
+  while (!window.closing() && !input.replay_finished() &&
+         Input::frame() < max_frames) {
+    if (render) {
+      ImGui_ImplOpenGL3_NewFrame();
+    }
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+    ImGui::DockSpaceOverViewport();
+    log_panel.draw();
+    ImGui::Render();
 
-  while (!window.closing()) {
-    window.swap_buffers();
+    frames.begin_frame();
+    if (render) {
+      glm::ivec2 size = window.framebuffer_size();
+      glViewport(0, 0, size.x, size.y);
+      glClear(GL_COLOR_BUFFER_BIT);
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+    frames.end_frame();
+
+    pacer.present();
     input.poll_events();
+    console.flush_expired_repeats();
+
+    if (replay_path != nullptr) {
+      auto frame_end = std::chrono::steady_clock::now();
+      frame_ms.push_back(
+          std::chrono::duration<double, std::milli>(frame_end - frame_begin)
+              .count());
+      frame_begin = frame_end;
+    }
   }
+  input.stop_recording();
+  _report_replay(frame_ms);
+  Input::latency().log();
+  pacer.log();
 
+  if (render) {
+    ImGui_ImplOpenGL3_Shutdown();
+  }
+  ImGui_ImplGlfw_Shutdown();
+  ImGui::DestroyContext();
+  // The fences go with the context
+  frames.destroy();
   window.destroy();
   console.destroy();
   return 0;
@@ -0,0 +1,185 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "panels/log_panel.h"
+#include <algorithm>
+#include <imgui.h>
+
+static ImVec4 _severity_color(int severity) {
+  switch (severity) {
+  case ConsoleOutput_SeverityTraceBit:
+    return ImVec4(0.50f, 0.50f, 0.50f, 1.0f);
+  case ConsoleOutput_SeverityVerboseBit:
+    return ImVec4(0.41f, 0.41f, 0.41f, 1.0f);
+  case ConsoleOutput_SeverityInfoBit:
+    return ImVec4(0.53f, 0.81f, 0.92f, 1.0f);
+  case ConsoleOutput_SeverityWarnBit:
+    return ImVec4(1.00f, 1.00f, 0.00f, 1.0f);
+  case ConsoleOutput_SeverityErrorBit:
+    return ImVec4(1.00f, 0.27f, 0.00f, 1.0f);
+  case ConsoleOutput_SeverityFatalBit:
+    return ImVec4(1.00f, 0.00f, 0.00f, 1.0f);
+  default:
+    return ImVec4(1.00f, 1.00f, 1.00f, 1.0f);
+  }
+}
+
+LogPanel::LogPanel(ConsoleRingOutput* ring)
+      : _ring(ring) {
+}
+
+void LogPanel::draw(const char* title, bool* open) {
+  if (!ImGui::Begin(title, open)) {
+    ImGui::End();
+    return;
+  }
+
+  static constexpr int s_Severities[] = {
+      ConsoleOutput_SeverityVerboseBit, ConsoleOutput_SeverityTraceBit,
+      ConsoleOutput_SeverityInfoBit,    ConsoleOutput_SeverityWarnBit,
+      ConsoleOutput_SeverityErrorBit,   ConsoleOutput_SeverityFatalBit,
+  };
+
+  bool rebuild = false;
+  bool clear   = false;
+  for (int bit : s_Severities) {
+    std::string_view name = console_severity_to_str(bit);
+    ImGui::PushID(bit);
+    rebuild |= ImGui::CheckboxFlags(name.data(), &_severity_filter, bit);
+    ImGui::PopID();
+    ImGui::SameLine();
+  }
+  ImGui::Checkbox("Auto-scroll", &_auto_scroll);
+  ImGui::SameLine();
+  if (ImGui::Button("Clear")) {
+    clear   = true;
+    rebuild = true;
+  }
+
+  // Context filters as of the last frame, new contexts start out shown
+  if (_contexts.size() > 1 && ImGui::TreeNode("Contexts")) {
+    for (size_t i = 1; i < _contexts.size(); i++) {
+      bool shown = _context_filter[i];
+      if (ImGui::Checkbox(_contexts[i].c_str(), &shown)) {
+        _context_filter[i] = shown;
+        rebuild            = true;
+      }
+    }
+    ImGui::TreePop();
+  }
+  ImGui::Separator();
+
+  {
+    auto lock = _ring->lock();
+    if (clear) {
+      _cleared_end = _ring->end_sequence();
+    }
+    const std::vector<std::string>& contexts = _ring->contexts();
+    _contexts.insert(_contexts.end(), contexts.begin() + _contexts.size(),
+                     contexts.end());
+    _context_filter.resize(_contexts.size(), true);
+
+    if (rebuild) {
+      _index.clear();
+      _index_begin = 0;
+      _indexed_end = 0;
+    }
+    _update_index();
+  }
+
+  ImGui::BeginChild("Messages", ImVec2(0.0f, 0.0f), ImGuiChildFlags_None,
+                    ImGuiWindowFlags_HorizontalScrollbar);
+  ImGuiListClipper clipper;
+  clipper.Begin((int)(_index.size() - _index_begin));
+  while (clipper.Step()) {
+    _copy_rows((size_t)clipper.DisplayStart, (size_t)clipper.DisplayEnd);
+    for (const ConsoleRingEntry& entry : _rows) {
+      if (entry.severity == ConsoleOutput_NoneBit) {
+        ImGui::NewLine();
+        continue;
+      }
+      ImGui::PushStyleColor(ImGuiCol_Text, _severity_color(entry.severity));
+      ImGui::TextUnformatted(console_severity_to_str(entry.severity).data());
+      ImGui::PopStyleColor();
+      if (entry.context != 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("[%s]", _contexts[entry.context].c_str());
+      }
+      ImGui::SameLine();
+      ImGui::TextUnformatted(entry.text.data(),
+                             entry.text.data() + entry.text.size());
+      if (ImGui::IsItemHovered() && entry.site != nullptr) {
+        ImGui::SetTooltip("%s:%d %s", entry.site->file, entry.site->line,
+                          entry.site->fn);
+      }
+    }
+  }
+  clipper.End();
+  if (_auto_scroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
+    ImGui::SetScrollHereY(1.0f);
+  }
+  ImGui::EndChild();
+
+  ImGui::End();
+}
+
+void LogPanel::_update_index() {
+  // Drop rows that were overwritten in the ring, compacting once the dead
+  // prefix is as large as the live part
+  uint64_t begin = std::max(_ring->begin_sequence(), _cleared_end);
+  while (_index_begin < _index.size() && _index[_index_begin] < begin) {
+    _index_begin++;
+  }
+  if (_index_begin > 0 && _index_begin >= _index.size() - _index_begin) {
+    _index.erase(_index.begin(), _index.begin() + _index_begin);
+    _index_begin = 0;
+  }
+
+  // Only messages that arrived since the last frame are tested
+  uint64_t end = _ring->end_sequence();
+  for (uint64_t seq = std::max(_indexed_end, begin); seq < end; seq++) {
+    if (_passes(_ring->entry(seq))) {
+      _index.push_back(seq);
+    }
+  }
+  _indexed_end = end;
+}
+
+void LogPanel::_copy_rows(size_t begin, size_t end) {
+  // Copying reuses the rows' text capacity, so this does not allocate once
+  // the panel has drawn a few frames
+  _rows.resize(end - begin);
+  auto lock = _ring->lock();
+  for (size_t row = begin; row < end; row++) {
+    uint64_t sequence             = _index[_index_begin + row];
+    const ConsoleRingEntry& entry = _ring->entry(sequence);
+    ConsoleRingEntry& copy        = _rows[row - begin];
+    if (entry.sequence == sequence) {
+      copy = entry;
+    } else {
+      // Overwritten since the index was updated, drawn as an empty row until
+      // the next frame drops it
+      copy.severity = ConsoleOutput_NoneBit;
+      copy.context  = 0;
+      copy.site     = nullptr;
+      copy.text.clear();
+    }
+  }
+}
+
+bool LogPanel::_passes(const ConsoleRingEntry& entry) const {
+  return (entry.severity & _severity_filter) &&
+         (entry.context >= _context_filter.size() ||
+          _context_filter[entry.context]);
+}
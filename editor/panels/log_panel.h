@@ -0,0 +1,60 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EDITOR_PANELS_LOG_PANEL_H
+#define EDITOR_PANELS_LOG_PANEL_H
+
+#include "core/console_ring.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ImGui window listing the messages of a ConsoleRingOutput.
+//
+// Only the visible rows are drawn (ImGuiListClipper). The rows that pass the
+// severity and context filters are kept as an index of sequence numbers that
+// is extended with the new messages every frame, and only rebuilt when a
+// filter changes.
+//
+// The ring's lock is only held to update the index and to copy the visible
+// rows, never across ImGui calls, so logging threads are not stalled for a
+// frame and a message logged while drawing does not deadlock.
+class LogPanel {
+public:
+  LogPanel(ConsoleRingOutput* ring);
+
+  void draw(const char* title = "Log", bool* open = nullptr);
+
+private:
+  void _update_index();
+  void _copy_rows(size_t begin, size_t end);
+  bool _passes(const ConsoleRingEntry& entry) const;
+
+private:
+  ConsoleRingOutput* _ring = nullptr;
+
+  int _severity_filter = ConsoleOutput::s_SeverityMask;
+  std::vector<std::string> _contexts;  // Copy of the ring's contexts
+  std::vector<bool> _context_filter;   // Indexed by context, true is shown
+  bool _auto_scroll = true;
+
+  std::vector<uint64_t> _index;
+  size_t _index_begin   = 0;  // Rows before this have left the ring
+  uint64_t _indexed_end = 0;  // Next sequence number to test
+  uint64_t _cleared_end = 0;  // Messages before this were cleared
+
+  std::vector<ConsoleRingEntry> _rows;  // Visible rows copied out of the ring
+};
+
+#endif
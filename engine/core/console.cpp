@@ -13,18 +13,172 @@
 // limitations under the License.
 
 #include "core/console.h"
+#include "core/console_binary.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fmt/color.h>
+#include <mutex>
+#include <thread>
 
-struct ConsoleMessage {
-  int line = -1;
-  std::string msg;
-  const char* file;
-  const char* fn;
-  const char* ctx;
-  int severity;
+// Bounded multi-producer queue (Vyukov), every slot carries a sequence number
+// so producers only contend on the enqueue position. The writer thread is the
+// regular consumer, producers also pop when overwriting the oldest message
+struct ConsoleAsyncSlot {
+  std::atomic<size_t> sequence = 0;
+  ConsoleMessage message;
+  std::string text;
+  std::string data;
+  bool formatted = false;  // text is filled, otherwise only data is
 };
 
+struct ConsoleAsyncQueue {
+  static constexpr auto s_WriterIdleTimeout = std::chrono::milliseconds(10);
+  // Yields of a blocked producer before it sleeps until the writer drained
+  static constexpr int s_BlockSpins = 64;
+
+  ConsoleAsyncQueue(size_t capacity)
+        : slots(capacity), mask(capacity - 1) {
+    for (size_t i = 0; i < capacity; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // - formatted: msg.msg holds the text, otherwise the writer formats it
+  //   from the encoded arguments in msg.data
+  bool push(const ConsoleMessage& msg, bool formatted);
+  bool pop(ConsoleMessage& msg, std::string& text, std::string& data,
+           bool& formatted);
+
+  std::vector<ConsoleAsyncSlot> slots;
+  size_t mask;
+
+  alignas(64) std::atomic<size_t> enqueue_pos = 0;
+  alignas(64) std::atomic<size_t> dequeue_pos = 0;
+  alignas(64) std::atomic<size_t> consumed    = 0;
+  std::atomic<size_t> flushed                 = 0;
+  std::atomic<size_t> dropped                 = 0;
+  std::atomic<bool> writer_idle               = false;
+  std::atomic<bool> running                   = true;
+
+  std::mutex mutex;
+  std::condition_variable wake_writer;
+  std::condition_variable wake_flush;
+  std::thread writer;
+};
+
+// Per thread formatting buffers, grown once and then reused. A message
+// printed from inside an output falls back to buffers on the stack
+struct ConsoleScratch {
+  fmt::memory_buffer text;
+  fmt::memory_buffer data;
+  bool in_use = false;
+};
+
+struct ConsoleOutputList {
+  std::vector<ConsoleOutput*> outputs;
+  int text_severity     = ConsoleOutput_NoneBit;
+  int deferred_severity = ConsoleOutput_NoneBit;
+};
+
+// Formats the text of a message that was queued with only its encoded
+// arguments, the same way the caller would have
+static void _format_encoded(
+    ConsoleMessage& msg, fmt::memory_buffer& out,
+    fmt::dynamic_format_arg_store<fmt::format_context>& store) {
+  store.clear();
+  if (console_decode_args(msg.data, store)) {
+    Console::format_message(out, msg.site->cond, msg.fmt, store);
+  } else {
+    out.clear();
+    out.append(msg.fmt.begin(), msg.fmt.end());
+  }
+  msg.msg = std::string_view(out.data(), out.size());
+}
+
 static Console* s_ptr = nullptr;
+static thread_local ConsoleScratch s_scratch;
+static thread_local fmt::memory_buffer s_output_buffer;
+static thread_local bool s_on_writer = false;
+
+std::atomic<int> Console::s_severity_mask = ConsoleOutput_NoneBit;
+std::atomic<const ConsoleCallSite*> Console::s_call_sites = nullptr;
+std::atomic<uint32_t> Console::s_call_site_count          = 0;
+
+bool ConsoleAsyncQueue::push(const ConsoleMessage& msg, bool formatted) {
+  size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+  ConsoleAsyncSlot* slot;
+  for (;;) {
+    slot                = &slots[pos & mask];
+    size_t seq          = slot->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+    if (diff == 0) {
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Assign field by field so the slot strings keep their capacity between
+  // laps. The arguments do not outlive the caller, only the encoded data
+  // and, where the caller had to format it, the text cross over to the
+  // writer thread
+  slot->message.site     = msg.site;
+  slot->message.severity = msg.severity;
+  slot->message.fmt      = msg.fmt;
+  slot->message.has_msg  = msg.has_msg;
+  slot->message.has_data = msg.has_data;
+  slot->message.window_hit      = msg.window_hit;
+  slot->message.previous_window = msg.previous_window;
+  slot->text.assign(msg.msg);
+  slot->data.assign(msg.data);
+  slot->formatted = formatted;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool ConsoleAsyncQueue::pop(ConsoleMessage& msg, std::string& text,
+                            std::string& data, bool& formatted) {
+  size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+  ConsoleAsyncSlot* slot;
+  for (;;) {
+    slot                = &slots[pos & mask];
+    size_t seq          = slot->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Swap rather than move so the strings are recycled
+  text.swap(slot->text);
+  data.swap(slot->data);
+  msg.site     = slot->message.site;
+  msg.severity = slot->message.severity;
+  msg.fmt      = slot->message.fmt;
+  msg.has_msg  = slot->message.has_msg;
+  msg.has_data = slot->message.has_data;
+  msg.window_hit      = slot->message.window_hit;
+  msg.previous_window = slot->message.previous_window;
+  msg.msg      = text;
+  msg.data     = data;
+  formatted    = slot->formatted;
+  slot->sequence.store(pos + mask + 1, std::memory_order_release);
+  return true;
+}
 
 const std::string_view console_severity_to_str(int severity) {
   switch (severity) {
@@ -45,7 +199,16 @@ const std::string_view console_severity_to_str(int severity) {
   }
 }
 
-std::string ConsoleOutput::_format_head(const ConsoleMessage& msg) {
+std::string_view ConsoleOutput::_format(const ConsoleMessage& msg) {
+  s_output_buffer.clear();
+  _format_head(s_output_buffer, msg);
+  _format_body(s_output_buffer, msg);
+  s_output_buffer.push_back('\n');
+  return std::string_view(s_output_buffer.data(), s_output_buffer.size());
+}
+
+void ConsoleOutput::_format_head(fmt::memory_buffer& out,
+                                 const ConsoleMessage& msg) {
   fmt::text_style style;
   if (_opts & ConsoleOutput_ColorBit) {
     switch (msg.severity) {
@@ -74,39 +237,118 @@ std::string ConsoleOutput::_format_head(const ConsoleMessage& msg) {
     }
   }
 
-  if (msg.ctx != nullptr) {
-    return fmt::format(style, "{} [{}]", console_severity_to_str(msg.severity),
-                       msg.ctx);
+  if (msg.site->ctx != nullptr) {
+    fmt::format_to(fmt::appender(out), style, "{} [{}]",
+                   console_severity_to_str(msg.severity), msg.site->ctx);
   } else {
-    return fmt::format(style, "{}", console_severity_to_str(msg.severity));
+    fmt::format_to(fmt::appender(out), style, "{}",
+                   console_severity_to_str(msg.severity));
   }
 }
 
-std::string ConsoleOutput::_format_body(const ConsoleMessage& msg) {
-  std::string body;
-  body.append(fmt::format(
-      "{}", (_opts & ConsoleOutput_BreakAfterHeaderBit) ? "\n" : " "));
-  bool include_meta_info = false;
+void ConsoleOutput::_format_body(fmt::memory_buffer& out,
+                                 const ConsoleMessage& msg) {
+  out.push_back((_opts & ConsoleOutput_BreakAfterHeaderBit) ? '\n' : ' ');
   if (msg.severity > ConsoleOutput_SeverityInfoBit) {
-    include_meta_info = true;
-    if (_opts & ~ConsoleOutput_FilterFileBit) {
-      body.append(fmt::format("file={} ", msg.file));
+    if (!(_opts & ConsoleOutput_FilterFileBit)) {
+      fmt::format_to(fmt::appender(out), "file={} ", msg.site->file);
     }
-    if (_opts & ~ConsoleOutput_FilterLineBit) {
-      body.append(fmt::format("line={} ", msg.line));
+    if (!(_opts & ConsoleOutput_FilterLineBit)) {
+      fmt::format_to(fmt::appender(out), "line={} ", msg.site->line);
     }
-    if (_opts & ~ConsoleOutput_FilterFunctionBit) {
-      body.append(fmt::format("func={} ", msg.fn));
+    if (!(_opts & ConsoleOutput_FilterFunctionBit)) {
+      fmt::format_to(fmt::appender(out), "func={} ", msg.site->fn);
+    }
+    if (_opts & ConsoleOutput_BreakAfterInfoBit) {
+      out.push_back('\n');
     }
   }
-  if (include_meta_info) {
-    body.append(fmt::format(
-        "{}{}", (_opts & ConsoleOutput_BreakAfterInfoBit) ? "\n" : "",
-        msg.msg));
-  } else {
-    body.append(msg.msg);
+  out.append(msg.msg.data(), msg.msg.data() + msg.msg.size());
+  if (msg.suppressed > 0) {
+    fmt::format_to(fmt::appender(out), " ({} more suppressed by rate limit)",
+                   msg.suppressed);
+  }
+  if (msg.repeats > 0) {
+    fmt::format_to(fmt::appender(out), " (repeated {} times)", msg.repeats);
+  }
+}
+
+void ConsoleOutput::receive(const ConsoleMessage& msg) {
+  ConsoleMessage limited;
+  if (msg.window_hit == 0) {
+    // Summary of a window the call site never printed in again
+    if (_rate_limit == 0 || msg.previous_window <= _rate_limit) {
+      return;
+    }
+    limited            = msg;
+    limited.suppressed = msg.previous_window - _rate_limit;
+    std::lock_guard<std::mutex> lock(_repeat_mutex);
+    _flush_repeats();
+    print_output(limited);
+    return;
+  }
+
+  const ConsoleMessage* print = &msg;
+  if (_rate_limit != 0) {
+    if (msg.window_hit > _rate_limit) {
+      return;
+    }
+    if (msg.previous_window > _rate_limit) {
+      limited            = msg;
+      limited.suppressed = msg.previous_window - _rate_limit;
+      print              = &limited;
+    }
+  }
+
+  bool coalesce = (_opts & ConsoleOutput_CoalesceBit) &&
+                  !(_opts & ConsoleOutput_DeferredFormatBit);
+  if (!coalesce) {
+    print_output(*print);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_repeat_mutex);
+  if (msg.site == _repeat_site && msg.msg == _repeat_text) {
+    // Long runs of repeats still report once per rate window
+    uint32_t now = Console::clock_ms();
+    if (_repeats++ == 0) {
+      _repeat_begin = now;
+    } else if (now - _repeat_begin >= Console::s_RateWindow) {
+      _flush_repeats();
+    }
+    return;
   }
-  return body;
+
+  _flush_repeats();
+  _repeat_site = msg.site;
+  _repeat_text.assign(msg.msg);
+  print_output(*print);
+}
+
+void ConsoleOutput::flush_repeats() {
+  std::lock_guard<std::mutex> lock(_repeat_mutex);
+  _flush_repeats();
+}
+
+void ConsoleOutput::flush_expired_repeats(uint32_t now) {
+  std::lock_guard<std::mutex> lock(_repeat_mutex);
+  if (_repeats > 0 && now - _repeat_begin >= Console::s_RateWindow) {
+    _flush_repeats();
+  }
+}
+
+void ConsoleOutput::_flush_repeats() {
+  if (_repeats == 0) {
+    return;
+  }
+  ConsoleMessage msg;
+  msg.site     = _repeat_site;
+  msg.severity = _repeat_site->severity;
+  msg.msg      = _repeat_text;
+  msg.has_msg  = true;
+  msg.repeats  = _repeats;
+  _repeats     = 0;
+  print_output(msg);
 }
 
 ConsoleTerminalOutput::ConsoleTerminalOutput(int flags)
@@ -118,40 +360,497 @@ void ConsoleTerminalOutput::print_output(const ConsoleMessage& msg) {
   if (msg.severity > ConsoleOutput_SeverityWarnBit) {
     out = stderr;
   }
-  fmt::println(out, "{}{}", _format_head(msg), _format_body(msg));
+  std::string_view text = _format(msg);
+  std::fwrite(text.data(), 1, text.size(), out);
   if (_opts & ConsoleOutput_FlushPerMessageBit) {
     std::fflush(out);
   }
 }
 
-void Console::print_to_outputs(int line, const std::string& msg,
-                               const char* file, const char* fn,
-                               const char* ctx, int severity) {
-  ConsoleMessage message {
-      .line     = line,
-      .msg      = msg,
-      .file     = file,
-      .fn       = fn,
-      .ctx      = ctx,
-      .severity = severity,
-  };
-  for (ConsoleOutput* output : s_ptr->_outputs) {
-    if (output->opts() & severity) {
-      output->print_output(message);
-    }
+void ConsoleTerminalOutput::flush() {
+  std::fflush(stdout);
+  std::fflush(stderr);
+}
+
+void Console::vprint_to_outputs(const ConsoleCallSite* site,
+                                fmt::string_view fmt, fmt::format_args args) {
+  if (site->id.load(std::memory_order_relaxed) == 0) {
+    _register_call_site(site);
+  }
+
+  ConsoleMessage message;
+  message.site     = site;
+  message.severity = site->severity;
+  message.fmt      = fmt;
+  message.args     = args;
+
+  // Count the print in the call site's rate window. Whoever moves the window
+  // forward reports the count of the window that ended
+  uint32_t now   = clock_ms();
+  uint32_t begin = site->window_begin.load(std::memory_order_relaxed);
+  if (now - begin >= s_RateWindow &&
+      site->window_begin.compare_exchange_strong(begin, now,
+                                                 std::memory_order_relaxed)) {
+    message.previous_window =
+        site->window_hits.exchange(0, std::memory_order_relaxed);
+  }
+  message.window_hit =
+      site->window_hits.fetch_add(1, std::memory_order_relaxed) + 1;
+
+  if (!s_scratch.in_use) {
+    s_scratch.in_use = true;
+    s_ptr->_print(message, s_scratch.text, s_scratch.data);
+    s_scratch.in_use = false;
+  } else {
+    fmt::memory_buffer text, data;
+    s_ptr->_print(message, text, data);
+  }
+}
+
+void Console::format_message(fmt::memory_buffer& out, const char* cond,
+                             fmt::string_view fmt, fmt::format_args args) {
+  out.clear();
+  if (cond != nullptr) {
+    fmt::format_to(fmt::appender(out), "`{}` == FALSE: ", cond);
   }
+  fmt::vformat_to(fmt::appender(out), fmt, args);
+}
+
+uint32_t Console::clock_ms() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
 }
 
-Console::Console() {
+Console::Console(int opts, size_t async_capacity)
+      : _opts(opts) {
+  BASIC_ASSERT(!_valid_options(opts),
+               "Can only create console with one or none overflow policies");
   s_ptr = this;
+  if (!(opts & Console_AsyncBit)) {
+    return;
+  }
+
+  size_t capacity = 2;
+  while (capacity < async_capacity) {
+    capacity <<= 1;
+  }
+  _queue         = new ConsoleAsyncQueue(capacity);
+  _queue->writer = std::thread(&Console::_async_writer, this);
 }
 
 void Console::destroy() {
-  for (ConsoleOutput* output : _outputs) {
+  if (_queue != nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(_queue->mutex);
+      _queue->running.store(false);
+    }
+    _queue->wake_writer.notify_one();
+    _queue->writer.join();
+
+    size_t dropped = _queue->dropped.load(std::memory_order_relaxed);
+    delete _queue;
+    _queue = nullptr;
+    if (dropped > 0) {
+      CONTEXT_WARN("CONSOLE", "Dropped {} messages, async queue overflowed",
+                   dropped);
+    }
+  }
+
+  // Windows still open are cut short, nothing would report them later
+  _flush_rate_windows(clock_ms(), true);
+  _flush_repeats();
+  _flush_outputs();
+
+  // Nothing may print past this point, so every retired list and output can
+  // go as well
+  s_severity_mask.store(ConsoleOutput_NoneBit, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(_outputs_mutex);
+  const ConsoleOutputList* outputs = _outputs.exchange(nullptr);
+  if (outputs != nullptr) {
+    for (ConsoleOutput* output : outputs->outputs) {
+      delete output;
+    }
+    delete outputs;
+  }
+  for (ConsoleOutput* output : _retired_outputs) {
     delete output;
   }
+  for (const ConsoleOutputList* list : _retired_lists) {
+    delete list;
+  }
+  _retired_outputs.clear();
+  _retired_lists.clear();
+}
+
+void Console::flush() {
+  // Waiting for the writer on its own thread would never return, flush what
+  // it has written so far instead
+  if (_queue == nullptr || s_on_writer) {
+    _flush_rate_windows(clock_ms(), false);
+    _flush_repeats();
+    _flush_outputs();
+    return;
+  }
+
+  size_t target = _queue->enqueue_pos.load(std::memory_order_acquire);
+  {
+    std::unique_lock<std::mutex> lock(_queue->mutex);
+    _queue->wake_writer.notify_one();
+    _queue->wake_flush.wait(lock, [this, target]() {
+      return _queue->flushed.load(std::memory_order_acquire) >= target ||
+             !_queue->running.load();
+    });
+  }
+
+  // Every message up to target has been received, summaries of repeats
+  // among them can go out now
+  _flush_rate_windows(clock_ms(), false);
+  _flush_repeats();
+  _flush_outputs();
+}
+
+void Console::flush_expired_repeats() {
+  const ConsoleOutputList* outputs = _outputs.load(std::memory_order_acquire);
+  if (outputs == nullptr) {
+    return;
+  }
+  uint32_t now = clock_ms();
+  for (ConsoleOutput* output : outputs->outputs) {
+    output->flush_expired_repeats(now);
+  }
+  _flush_rate_windows(now, false);
 }
 
 void Console::add_output(ConsoleOutput* output) {
-  _outputs.push_back(output);
+  std::lock_guard<std::mutex> lock(_outputs_mutex);
+  const ConsoleOutputList* current = _outputs.load(std::memory_order_relaxed);
+  ConsoleOutputList* outputs       = new ConsoleOutputList();
+  if (current != nullptr) {
+    outputs->outputs = current->outputs;
+  }
+  outputs->outputs.push_back(output);
+  _publish_outputs(outputs);
+}
+
+void Console::remove_output(ConsoleOutput* output) {
+  std::lock_guard<std::mutex> lock(_outputs_mutex);
+  const ConsoleOutputList* current = _outputs.load(std::memory_order_relaxed);
+  if (current == nullptr) {
+    return;
+  }
+  auto it = std::find(current->outputs.begin(), current->outputs.end(), output);
+  if (it == current->outputs.end()) {
+    return;
+  }
+
+  ConsoleOutputList* outputs = new ConsoleOutputList();
+  outputs->outputs           = current->outputs;
+  outputs->outputs.erase(outputs->outputs.begin() +
+                         (it - current->outputs.begin()));
+  _retired_outputs.push_back(output);
+  _publish_outputs(outputs);
+  output->flush_repeats();
+}
+
+void Console::_register_call_site(const ConsoleCallSite* site) {
+  // Racing first prints of the same site may both draw an id, only the one
+  // that sticks links the site. Ids are therefore unique but can have gaps
+  uint32_t id       = s_call_site_count.fetch_add(1) + 1;
+  uint32_t expected = 0;
+  if (!site->id.compare_exchange_strong(expected, id)) {
+    return;
+  }
+  const ConsoleCallSite* head = s_call_sites.load(std::memory_order_relaxed);
+  do {
+    site->next = head;
+  } while (!s_call_sites.compare_exchange_weak(head, site,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+}
+
+bool Console::_valid_options(int opts) {
+  int target = Console_OverflowDropBit | Console_OverflowBlockBit |
+               Console_OverflowOverwriteBit;
+  int enabled = target & opts;
+  return enabled == 0 || enabled == Console_OverflowDropBit ||
+         enabled == Console_OverflowBlockBit ||
+         enabled == Console_OverflowOverwriteBit;
+}
+
+void Console::_print(ConsoleMessage& msg, fmt::memory_buffer& text,
+                     fmt::memory_buffer& data) {
+  const ConsoleOutputList* outputs = _outputs.load(std::memory_order_acquire);
+  if (outputs == nullptr || _rate_limited(*outputs, msg)) {
+    return;
+  }
+  if (_queue == nullptr || s_on_writer) {
+    _prepare_message(*outputs, msg, text, data, false);
+    _write_to_outputs(*outputs, msg);
+    if (msg.severity & ConsoleOutput_SeverityFatalBit) {
+      _flush_outputs();
+    }
+    return;
+  }
+
+  bool formatted = _prepare_message(*outputs, msg, text, data, true);
+  for (int spins = 0; !_queue->push(msg, formatted); spins++) {
+    if (_opts & Console_OverflowDropBit) {
+      _queue->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else if (_opts & Console_OverflowOverwriteBit) {
+      static thread_local std::string s_discard_text, s_discard_data;
+      ConsoleMessage oldest;
+      bool discard_formatted = false;
+      if (_queue->pop(oldest, s_discard_text, s_discard_data,
+                      discard_formatted)) {
+        _queue->dropped.fetch_add(1, std::memory_order_relaxed);
+        _queue->consumed.fetch_add(1, std::memory_order_release);
+      }
+    } else if (spins < ConsoleAsyncQueue::s_BlockSpins) {
+      _queue->wake_writer.notify_one();
+      std::this_thread::yield();
+    } else {
+      // The writer signals wake_flush after every drained batch
+      std::unique_lock<std::mutex> lock(_queue->mutex);
+      size_t flushed = _queue->flushed.load(std::memory_order_acquire);
+      _queue->wake_writer.notify_one();
+      _queue->wake_flush.wait_for(
+          lock, ConsoleAsyncQueue::s_WriterIdleTimeout, [this, flushed]() {
+            return _queue->flushed.load(std::memory_order_acquire) !=
+                       flushed ||
+                   !_queue->running.load();
+          });
+    }
+  }
+  if (_queue->writer_idle.load()) {
+    _queue->wake_writer.notify_one();
+  }
+  if (msg.severity & ConsoleOutput_SeverityFatalBit) {
+    flush();
+  }
+}
+
+bool Console::_rate_limited(const ConsoleOutputList& outputs,
+                            const ConsoleMessage& msg) {
+  // Skip formatting when every output would drop the message anyway
+  for (ConsoleOutput* output : outputs.outputs) {
+    if ((output->opts() & msg.severity) &&
+        (output->rate_limit() == 0 || msg.window_hit <= output->rate_limit())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Console::_prepare_message(const ConsoleOutputList& outputs,
+                               ConsoleMessage& msg, fmt::memory_buffer& text,
+                               fmt::memory_buffer& data, bool defer_text) {
+  bool needs_text = outputs.text_severity & msg.severity;
+  bool needs_data = outputs.deferred_severity & msg.severity;
+  bool exact      = true;
+  if (needs_data || (needs_text && defer_text)) {
+    data.clear();
+    exact        = console_encode_args(data, msg.args);
+    msg.data     = std::string_view(data.data(), data.size());
+    msg.has_data = needs_data;
+  }
+  if (!needs_text) {
+    return false;
+  }
+
+  // Arguments only kept as their text may not take the spec they are
+  // formatted with, those messages are still formatted by the caller
+  msg.has_msg = true;
+  if (defer_text && exact) {
+    return false;
+  }
+  format_message(text, msg.site->cond, msg.fmt, msg.args);
+  msg.msg = std::string_view(text.data(), text.size());
+  return true;
+}
+
+void Console::_write_to_outputs(const ConsoleOutputList& outputs,
+                                const ConsoleMessage& msg) {
+  if (msg.has_msg) {
+    _track_rate_limit(outputs, msg);
+  }
+  for (ConsoleOutput* output : outputs.outputs) {
+    if (!(output->opts() & msg.severity)) {
+      continue;
+    }
+
+    // A queued message only carries what the outputs at the time it was
+    // printed needed, outputs added since then may not get it
+    bool deferred = output->opts() & ConsoleOutput_DeferredFormatBit;
+    if (deferred ? msg.has_data : msg.has_msg) {
+      output->receive(msg);
+    }
+  }
+}
+
+void Console::_flush_outputs() {
+  const ConsoleOutputList* outputs = _outputs.load(std::memory_order_acquire);
+  if (outputs == nullptr) {
+    return;
+  }
+  for (ConsoleOutput* output : outputs->outputs) {
+    output->flush();
+  }
+}
+
+void Console::_flush_repeats() {
+  const ConsoleOutputList* outputs = _outputs.load(std::memory_order_acquire);
+  if (outputs == nullptr) {
+    return;
+  }
+  for (ConsoleOutput* output : outputs->outputs) {
+    output->flush_repeats();
+  }
+}
+
+void Console::_track_rate_limit(const ConsoleOutputList& outputs,
+                                const ConsoleMessage& msg) {
+  // The last message an output prints in the window, anything after it is
+  // suppressed until the window ends
+  bool limited = false;
+  for (ConsoleOutput* output : outputs.outputs) {
+    limited |= (output->opts() & msg.severity) &&
+               !(output->opts() & ConsoleOutput_DeferredFormatBit) &&
+               output->rate_limit() == msg.window_hit;
+  }
+  if (!limited) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_limited_mutex);
+  auto it = std::find_if(
+      _limited.begin(), _limited.end(),
+      [&msg](const LimitedSite& limited) { return limited.site == msg.site; });
+  LimitedSite& site = it != _limited.end() ? *it : _limited.emplace_back();
+  site.site         = msg.site;
+  site.window_begin = msg.site->window_begin.load(std::memory_order_relaxed);
+  site.text.assign(msg.msg);
+}
+
+void Console::_flush_rate_windows(uint32_t now, bool all) {
+  std::vector<LimitedSite> ended;
+  {
+    std::lock_guard<std::mutex> lock(_limited_mutex);
+    for (size_t i = 0; i < _limited.size();) {
+      LimitedSite& limited        = _limited[i];
+      const ConsoleCallSite* site = limited.site;
+
+      uint32_t begin = site->window_begin.load(std::memory_order_relaxed);
+      if (begin == limited.window_begin && !all &&
+          now - begin < s_RateWindow) {
+        i++;
+        continue;
+      }
+      // Moving the window forward the way a print does keeps the next
+      // message from reporting it again. When a print moved it first, that
+      // message already carried the count
+      if (begin == limited.window_begin &&
+          site->window_begin.compare_exchange_strong(
+              begin, now, std::memory_order_relaxed)) {
+        limited.window_hits =
+            site->window_hits.exchange(0, std::memory_order_relaxed);
+        ended.push_back(std::move(limited));
+      }
+      std::swap(_limited[i], _limited.back());
+      _limited.pop_back();
+    }
+  }
+
+  // Outputs may print from inside receive, which has to happen unlocked
+  const ConsoleOutputList* outputs = _outputs.load(std::memory_order_acquire);
+  if (outputs == nullptr) {
+    return;
+  }
+  for (const LimitedSite& limited : ended) {
+    ConsoleMessage msg;
+    msg.site            = limited.site;
+    msg.severity        = limited.site->severity;
+    msg.msg             = limited.text;
+    msg.has_msg         = true;
+    msg.previous_window = limited.window_hits;
+    for (ConsoleOutput* output : outputs->outputs) {
+      if ((output->opts() & msg.severity) &&
+          !(output->opts() & ConsoleOutput_DeferredFormatBit)) {
+        output->receive(msg);
+      }
+    }
+  }
+}
+
+void Console::_publish_outputs(ConsoleOutputList* outputs) {
+  int severity_mask = ConsoleOutput_NoneBit;
+  for (ConsoleOutput* output : outputs->outputs) {
+    int severity = output->opts() & ConsoleOutput::s_SeverityMask;
+    if (output->opts() & ConsoleOutput_DeferredFormatBit) {
+      outputs->deferred_severity |= severity;
+    } else {
+      outputs->text_severity |= severity;
+    }
+    severity_mask |= severity;
+  }
+
+  const ConsoleOutputList* previous =
+      _outputs.exchange(outputs, std::memory_order_acq_rel);
+  if (previous != nullptr) {
+    _retired_lists.push_back(previous);
+  }
+  s_severity_mask.store(severity_mask, std::memory_order_relaxed);
+}
+
+void Console::_async_writer() {
+  s_on_writer = true;
+  ConsoleMessage msg;
+  std::string text, data;
+  fmt::memory_buffer deferred_text;
+  fmt::dynamic_format_arg_store<fmt::format_context> deferred_args;
+  bool formatted = false;
+  for (;;) {
+    size_t written = 0;
+    while (_queue->pop(msg, text, data, formatted)) {
+      if (msg.has_msg && !formatted) {
+        _format_encoded(msg, deferred_text, deferred_args);
+      }
+      const ConsoleOutputList* outputs =
+          _outputs.load(std::memory_order_acquire);
+      if (outputs != nullptr) {
+        _write_to_outputs(*outputs, msg);
+      }
+      _queue->consumed.fetch_add(1, std::memory_order_release);
+      written++;
+    }
+
+    // Flush once per drained batch instead of once per message. The writer
+    // wakes up at least every s_WriterIdleTimeout, often enough to report
+    // runs of repeats that stopped
+    flush_expired_repeats();
+    if (written > 0) {
+      _flush_outputs();
+    }
+    {
+      std::lock_guard<std::mutex> lock(_queue->mutex);
+      _queue->flushed.store(_queue->consumed.load(std::memory_order_acquire),
+                            std::memory_order_release);
+    }
+    _queue->wake_flush.notify_all();
+
+    std::unique_lock<std::mutex> lock(_queue->mutex);
+    bool empty = _queue->dequeue_pos.load() == _queue->enqueue_pos.load();
+    if (!_queue->running.load() && empty) {
+      break;
+    }
+    _queue->writer_idle.store(true);
+    _queue->wake_writer.wait_for(lock, ConsoleAsyncQueue::s_WriterIdleTimeout,
+                                 [this]() {
+                                   return _queue->dequeue_pos.load() !=
+                                              _queue->enqueue_pos.load() ||
+                                          !_queue->running.load();
+                                 });
+    _queue->writer_idle.store(false);
+  }
 }
@@ -16,27 +16,55 @@
 #define CORE_CONSOLE_H
 
 #include "core/defines.h"
+#include <atomic>
 #include <fmt/format.h>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <vector>
 
+// Severities below this are compiled out entirely, the call site including
+// its arguments disappears. Set through FIWRE_CONSOLE_MIN_SEVERITY in CMake
+#ifndef CONSOLE_MIN_SEVERITY
+#define CONSOLE_MIN_SEVERITY ConsoleOutput_SeverityVerboseBit
+#endif
+
+#define INTERNAL_SEVERITY_BIT(_severity) ConsoleOutput_Severity##_severity##Bit
+
+// Every expansion owns one ConsoleCallSite in static storage, messages only
+// pass a pointer to it. _every_n prints every n-th hit, 0 only prints once
+#define INTERNAL_PRINT_EVERY_N(_context, _condition_str, _severity, _every_n,  \
+                               ...)                                            \
+  if constexpr (INTERNAL_SEVERITY_BIT(_severity) >= CONSOLE_MIN_SEVERITY) {    \
+    static constexpr ConsoleCallSite _console_site(                            \
+        __LINE__, __FILE__, __FUNCTION__, (_context), (_condition_str),        \
+        INTERNAL_SEVERITY_BIT(_severity));                                     \
+    if (Console::severity_enabled(INTERNAL_SEVERITY_BIT(_severity)) &&         \
+        _console_site.should_print(_every_n)) {                                \
+      Console::print_to_outputs(&_console_site, __VA_ARGS__);                  \
+    }                                                                          \
+  } else                                                                       \
+    ((void)0)
+
+#define INTERNAL_PRINT(_context, _condition_str, _severity, ...)               \
+  INTERNAL_PRINT_EVERY_N(_context, _condition_str, _severity, 1, __VA_ARGS__)
+
 #define INTERNAL_MSG(_context, _severity, ...)                                 \
-  Console::print_to_outputs(__LINE__, fmt::format(__VA_ARGS__), __FILE__,      \
-                            __FUNCTION__, (_context),                          \
-                            ConsoleOutput_Severity##_severity##Bit)
+  INTERNAL_PRINT(_context, nullptr, _severity, __VA_ARGS__)
+
+#define INTERNAL_MSG_ONCE(_context, _severity, ...)                            \
+  INTERNAL_PRINT_EVERY_N(_context, nullptr, _severity, 0, __VA_ARGS__)
+
+#define INTERNAL_MSG_EVERY_N(_context, _severity, _n, ...)                     \
+  INTERNAL_PRINT_EVERY_N(_context, nullptr, _severity, (_n), __VA_ARGS__)
 
 #define INTERNAL_MSG_RETURN(_context, _returning, _severity, ...)              \
-  Console::print_to_outputs(__LINE__, fmt::format(__VA_ARGS__), __FILE__,      \
-                            __FUNCTION__, (_context),                          \
-                            ConsoleOutput_Severity##_severity##Bit);           \
+  INTERNAL_PRINT(_context, nullptr, _severity, __VA_ARGS__);                   \
   return (_returning)
 
 #ifndef NDEBUG
 #define INTERNAL_FATAL_MSG(_context, _severity, ...)                           \
-  Console::print_to_outputs(__LINE__, fmt::format(__VA_ARGS__), __FILE__,      \
-                            __FUNCTION__, (_context),                          \
-                            ConsoleOutput_Severity##_severity##Bit);           \
+  INTERNAL_PRINT(_context, nullptr, _severity, __VA_ARGS__);                   \
   GENERATE_TRAP()
 #else
 #define INTERNAL_FATAL_MSG(_context, _severity, ...)
@@ -44,12 +72,7 @@
 
 #define INTERNAL_CONDITION(_context, _condition, _severity, ...)               \
   if (!(_condition)) {                                                         \
-    Console::print_to_outputs(                                                 \
-        __LINE__,                                                              \
-        fmt::format(fmt::format("`{}` == FALSE: ", #_condition) +              \
-                    __VA_ARGS__),                                              \
-        __FILE__, __FUNCTION__, (_context),                                    \
-        ConsoleOutput_Severity##_severity##Bit);                               \
+    INTERNAL_PRINT(_context, #_condition, _severity, __VA_ARGS__);             \
     return;                                                                    \
   } else                                                                       \
     ((void)0)
@@ -57,12 +80,7 @@
 #define INTERNAL_CONDITION_RETURN(_context, _returning, _condition, _severity, \
                                   ...)                                         \
   if (!(_condition)) {                                                         \
-    Console::print_to_outputs(                                                 \
-        __LINE__,                                                              \
-        fmt::format(fmt::format("`{}` == FALSE: ", #_condition) +              \
-                    __VA_ARGS__),                                              \
-        __FILE__, __FUNCTION__, (_context),                                    \
-        ConsoleOutput_Severity##_severity##Bit);                               \
+    INTERNAL_PRINT(_context, #_condition, _severity, __VA_ARGS__);             \
     return (_returning);                                                       \
   } else                                                                       \
     ((void)0)
@@ -70,12 +88,7 @@
 #ifndef NDEBUG
 #define INTERNAL_FATAL_CONDITION(_context, _condition, _severity, ...)         \
   if (!(_condition)) {                                                         \
-    Console::print_to_outputs(                                                 \
-        __LINE__,                                                              \
-        fmt::format(fmt::format("`{}` == FALSE: ", #_condition) +              \
-                    __VA_ARGS__),                                              \
-        __FILE__, __FUNCTION__, (_context),                                    \
-        ConsoleOutput_Severity##_severity##Bit);                               \
+    INTERNAL_PRINT(_context, #_condition, _severity, __VA_ARGS__);             \
     GENERATE_TRAP();                                                           \
   } else                                                                       \
     ((void)0)
@@ -89,7 +102,7 @@
 #define VERBOSE(...) INTERNAL_MSG(nullptr, Verbose, __VA_ARGS__)
 #define TRACE(...) INTERNAL_MSG(nullptr, Trace, __VA_ARGS__)
 #define INFO(...) INTERNAL_MSG(nullptr, Info, __VA_ARGS__)
-#define WARN(...) INTERNAL_MSG(nullptr, Warning, __VA_ARGS__)
+#define WARN(...) INTERNAL_MSG(nullptr, Warn, __VA_ARGS__)
 #define ERROR(...) INTERNAL_MSG(nullptr, Error, __VA_ARGS__)
 #define FATAL(...) INTERNAL_FATAL_MSG(nullptr, Fatal, __VA_ARGS__)
 
@@ -97,34 +110,65 @@
   INTERNAL_MSG(_context, Verbose, __VA_ARGS__)
 #define CONTEXT_TRACE(_context, ...) INTERNAL_MSG(_context, Trace, __VA_ARGS__)
 #define CONTEXT_INFO(_context, ...) INTERNAL_MSG(_context, Info, __VA_ARGS__)
-#define CONTEXT_WARN(_context, ...) INTERNAL_MSG(_context, Warning, __VA_ARGS__)
+#define CONTEXT_WARN(_context, ...) INTERNAL_MSG(_context, Warn, __VA_ARGS__)
 #define CONTEXT_ERROR(_context, ...) INTERNAL_MSG(_context, Error, __VA_ARGS__)
 #define CONTEXT_FATAL(_context, ...)                                           \
   INTERNAL_FATAL_MSG(_context, Fatal, __VA_ARGS__)
 
+// Once / Every N
+// ------------------------------------------------------------------------------------------------
+#define INFO_ONCE(...) INTERNAL_MSG_ONCE(nullptr, Info, __VA_ARGS__)
+#define WARN_ONCE(...) INTERNAL_MSG_ONCE(nullptr, Warn, __VA_ARGS__)
+#define ERROR_ONCE(...) INTERNAL_MSG_ONCE(nullptr, Error, __VA_ARGS__)
+
+#define TRACE_EVERY_N(_n, ...)                                                 \
+  INTERNAL_MSG_EVERY_N(nullptr, Trace, _n, __VA_ARGS__)
+#define INFO_EVERY_N(_n, ...)                                                  \
+  INTERNAL_MSG_EVERY_N(nullptr, Info, _n, __VA_ARGS__)
+#define WARN_EVERY_N(_n, ...)                                                  \
+  INTERNAL_MSG_EVERY_N(nullptr, Warn, _n, __VA_ARGS__)
+#define ERROR_EVERY_N(_n, ...)                                                 \
+  INTERNAL_MSG_EVERY_N(nullptr, Error, _n, __VA_ARGS__)
+
+#define CONTEXT_INFO_ONCE(_context, ...)                                       \
+  INTERNAL_MSG_ONCE(_context, Info, __VA_ARGS__)
+#define CONTEXT_WARN_ONCE(_context, ...)                                       \
+  INTERNAL_MSG_ONCE(_context, Warn, __VA_ARGS__)
+#define CONTEXT_ERROR_ONCE(_context, ...)                                      \
+  INTERNAL_MSG_ONCE(_context, Error, __VA_ARGS__)
+
+#define CONTEXT_TRACE_EVERY_N(_context, _n, ...)                               \
+  INTERNAL_MSG_EVERY_N(_context, Trace, _n, __VA_ARGS__)
+#define CONTEXT_INFO_EVERY_N(_context, _n, ...)                                \
+  INTERNAL_MSG_EVERY_N(_context, Info, _n, __VA_ARGS__)
+#define CONTEXT_WARN_EVERY_N(_context, _n, ...)                                \
+  INTERNAL_MSG_EVERY_N(_context, Warn, _n, __VA_ARGS__)
+#define CONTEXT_ERROR_EVERY_N(_context, _n, ...)                               \
+  INTERNAL_MSG_EVERY_N(_context, Error, _n, __VA_ARGS__)
+
 // Return Value
 // ------------------------------------------------------------------------------------------------
 #define WARN_RETURN(_returning, ...)                                           \
-  INTERNAL_MSG_RETURN(nullptr, _returning, Warning, __VA_ARGS__)
+  INTERNAL_MSG_RETURN(nullptr, _returning, Warn, __VA_ARGS__)
 #define ERROR_RETURN(_returning, ...)                                          \
   INTERNAL_MSG_RETURN(nullptr, _returning, Error, __VA_ARGS__)
 
 #define CONTEXT_WARN_RETURN(_context, _returning, ...)                         \
-  INTERNAL_MSG_RETURN(_context, _returning, Warning, __VA_ARGS__)
+  INTERNAL_MSG_RETURN(_context, _returning, Warn, __VA_ARGS__)
 #define CONTEXT_ERROR_RETURN(_context, _returning, ...)                        \
   INTERNAL_MSG_RETURN(_context, _returning, Error, __VA_ARGS__)
 
 // Conditions
 // ------------------------------------------------------------------------------------------------
 #define CONDITION_WARN(_condition, ...)                                        \
-  INTERNAL_CONDITION(nullptr, _condition, Warning, __VA_ARGS__);
+  INTERNAL_CONDITION(nullptr, _condition, Warn, __VA_ARGS__);
 #define CONDITION_ERROR(_condition, ...)                                       \
   INTERNAL_CONDITION(nullptr, _condition, Error, __VA_ARGS__);
 #define CONDITION_FATAL(_condition, ...)                                       \
   INTERNAL_FATAL_CONDITION(nullptr, _condition, Fatal, __VA_ARGS__);
 
 #define CONDITION_WARN_RETURN(_condition, _returning, ...)                     \
-  INTERNAL_CONDITION_RETURN(nullptr, _returning, _condition, Warning,          \
+  INTERNAL_CONDITION_RETURN(nullptr, _returning, _condition, Warn,             \
                             __VA_ARGS__);
 #define CONDITION_ERROR_RETURN(_condition, _returning, ...)                    \
   INTERNAL_CONDITION_RETURN(nullptr, _returning, _condition, Error,            \
@@ -133,14 +177,14 @@
 // Context
 // ------------------------------------------------------------------------------------------------
 #define CONTEXT_CONDITION_WARN(_context, _condition, ...)                      \
-  INTERNAL_CONDITION(_context, _condition, Warning, __VA_ARGS__);
+  INTERNAL_CONDITION(_context, _condition, Warn, __VA_ARGS__);
 #define CONTEXT_CONDITION_ERROR(_context, _condition, ...)                     \
   INTERNAL_CONDITION(_context, _condition, Error, __VA_ARGS__);
 #define CONTEXT_CONDITION_FATAL(_context, _condition, ...)                     \
   INTERNAL_FATAL_CONDITION(_context, _condition, Fatal, __VA_ARGS__);
 
 #define CONTEXT_CONDITION_WARN_RETURN(_context, _condition, _returning, ...)   \
-  INTERNAL_CONDITION_RETURN(_context, _returning, _condition, Warning,         \
+  INTERNAL_CONDITION_RETURN(_context, _returning, _condition, Warn,            \
                             __VA_ARGS__);
 #define CONTEXT_CONDITION_ERROR_RETURN(_context, _condition, _returning, ...)  \
   INTERNAL_CONDITION_RETURN(_context, _returning, _condition, Error,           \
@@ -206,8 +250,6 @@
 
 #endif
 
-struct ConsoleMessage;
-
 enum ConsoleOutputFlag {
   ConsoleOutput_NoneBit             = 0,
   ConsoleOutput_FlushPerMessageBit  = 1 << 0,
@@ -224,6 +266,80 @@ enum ConsoleOutputFlag {
   ConsoleOutput_SeverityWarnBit    = 1 << 10,
   ConsoleOutput_SeverityErrorBit   = 1 << 11,
   ConsoleOutput_SeverityFatalBit   = 1 << 12,
+
+  // Output receives the encoded arguments in ConsoleMessage::data instead of
+  // the formatted text, see core/console_binary.h
+  ConsoleOutput_DeferredFormatBit = 1 << 13,
+  // Identical consecutive messages are printed once, followed by a
+  // "repeated N times" summary. Ignored by deferred outputs
+  ConsoleOutput_CoalesceBit = 1 << 14,
+};
+
+// Compile time description of a console macro expansion plus the little
+// runtime state that belongs to it. Sites link themselves into
+// Console::call_sites() the first time they print
+struct ConsoleCallSite {
+  int line         = -1;
+  const char* file = nullptr;
+  const char* fn   = nullptr;
+  const char* ctx  = nullptr;
+  const char* cond = nullptr;  // Failed expression of the CONDITION macros
+  int severity     = ConsoleOutput_NoneBit;
+
+  mutable std::atomic<bool> enabled   = true;
+  mutable std::atomic<uint32_t> hits  = 0;
+  mutable std::atomic<uint32_t> id    = 0;  // 0 until registered
+  mutable const ConsoleCallSite* next = nullptr;
+
+  // Prints in the current rate limit window, see ConsoleOutput::set_rate_limit
+  mutable std::atomic<uint32_t> window_begin = 0;
+  mutable std::atomic<uint32_t> window_hits  = 0;
+
+  constexpr ConsoleCallSite(int line, const char* file, const char* fn,
+                            const char* ctx, const char* cond, int severity)
+        : line(line), file(file), fn(fn), ctx(ctx), cond(cond),
+          severity(severity) {}
+
+  inline void set_enabled(bool enable) const {
+    enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  inline bool should_print(uint32_t every_n) const {
+    if (!enabled.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    uint32_t hit = hits.fetch_add(1, std::memory_order_relaxed);
+    return every_n == 0 ? hit == 0 : hit % every_n == 0;
+  }
+};
+
+struct ConsoleMessage {
+  const ConsoleCallSite* site = nullptr;
+  int severity                = ConsoleOutput_NoneBit;
+
+  // Format string literal and its arguments, args is only valid while
+  // Console::print_to_outputs is on the stack
+  fmt::string_view fmt;
+  fmt::format_args args;
+
+  // Formatted text for regular outputs, encoded args for deferred outputs.
+  // Each is only filled (and has_* set) when an output subscribed to the
+  // severity needs it, both point into buffers owned by the console
+  std::string_view msg;
+  std::string_view data;
+  bool has_msg  = false;
+  bool has_data = false;
+
+  // Rate limiting, the 1 based count of the call site in the current window
+  // and, on the message that opened a new window, the count of the last one.
+  // A window_hit of 0 marks the summary of a window that ended without the
+  // site printing again, see Console::flush_expired_repeats()
+  uint32_t window_hit      = 0;
+  uint32_t previous_window = 0;
+
+  // Summaries added by ConsoleOutput, printed after the message text
+  uint32_t repeats    = 0;
+  uint32_t suppressed = 0;
 };
 
 const std::string_view console_severity_to_str(int severity);
@@ -236,6 +352,10 @@ public:
   static constexpr int s_DefaultSeverity = ConsoleOutput_SeverityWarnBit |
                                            ConsoleOutput_SeverityErrorBit |
                                            ConsoleOutput_SeverityFatalBit;
+  static constexpr int s_SeverityMask =
+      ConsoleOutput_SeverityVerboseBit | ConsoleOutput_SeverityTraceBit |
+      ConsoleOutput_SeverityInfoBit | ConsoleOutput_SeverityWarnBit |
+      ConsoleOutput_SeverityErrorBit | ConsoleOutput_SeverityFatalBit;
 
 public:
   ConsoleOutput(int opts = s_DefaultOptions)
@@ -247,12 +367,50 @@ public:
 
   virtual std::string_view name() const                = 0;
   virtual void print_output(const ConsoleMessage& msg) = 0;
+  virtual void flush() {}
+
+  // Applies the rate limit and coalescing, then hands the message to
+  // print_output. This is what the console calls
+  void receive(const ConsoleMessage& msg);
+
+  // Prints the summary of messages still being coalesced
+  void flush_repeats();
+  // Same, but only once the run has lasted a whole Console::s_RateWindow
+  // - now: Console::clock_ms()
+  void flush_expired_repeats(uint32_t now);
+
+  // Every call site may send at most max_per_window messages per
+  // Console::s_RateWindow to this output, 0 disables the limit. The first
+  // message after a limited window says how many were suppressed, or the
+  // last one printed in it is repeated with the count once the window ended
+  inline void set_rate_limit(uint32_t max_per_window) {
+    _rate_limit = max_per_window;
+  }
+  inline uint32_t rate_limit() const { return _rate_limit; }
 
-  virtual std::string _format_head(const ConsoleMessage& msg);
-  virtual std::string _format_body(const ConsoleMessage& msg);
+  // Formats head and body followed by a line break into a thread local
+  // buffer, the view is valid until the next call on the same thread
+  std::string_view _format(const ConsoleMessage& msg);
+
+  virtual void _format_head(fmt::memory_buffer& out,
+                            const ConsoleMessage& msg);
+  virtual void _format_body(fmt::memory_buffer& out,
+                            const ConsoleMessage& msg);
 
 protected:
   int _opts;
+
+private:
+  void _flush_repeats();
+
+private:
+  uint32_t _rate_limit = 0;
+
+  std::mutex _repeat_mutex;
+  const ConsoleCallSite* _repeat_site = nullptr;
+  std::string _repeat_text;
+  uint32_t _repeats      = 0;
+  uint32_t _repeat_begin = 0;  // Console::clock_ms() of the first repeat
 };
 
 class ConsoleTerminalOutput : public ConsoleOutput {
@@ -265,29 +423,157 @@ public:
     return "Error Terminal Output";
   }
   void print_output(const ConsoleMessage& msg) override;
+  void flush() override;
+};
+
+struct ConsoleAsyncQueue;
+struct ConsoleOutputList;
+
+enum ConsoleFlag {
+  Console_NoneBit              = 0,
+  Console_AsyncBit             = 1 << 0,
+  Console_OverflowDropBit      = 1 << 1,
+  Console_OverflowBlockBit     = 1 << 2,
+  Console_OverflowOverwriteBit = 1 << 3,
 };
 
 class Console {
 public:
-  static void print_to_outputs(int line, const std::string& msg,
-                               const char* file, const char* fn,
-                               const char* ctx, int severity);
+  static constexpr int s_DefaultOptions          = Console_NoneBit;
+  static constexpr size_t s_DefaultAsyncCapacity = 4096;
+  static constexpr uint32_t s_RateWindow         = 1000;  // Milliseconds
+
+public:
+  template <typename... TArgs>
+  static void print_to_outputs(const ConsoleCallSite* site,
+                               fmt::format_string<TArgs...> fmt,
+                               TArgs&&... args) {
+    vprint_to_outputs(site, fmt, fmt::make_format_args(args...));
+  }
+
+  static void vprint_to_outputs(const ConsoleCallSite* site,
+                                fmt::string_view fmt, fmt::format_args args);
+
+  // Formats the message text the way the macros intended it, including the
+  // failed condition prefix
+  static void format_message(fmt::memory_buffer& out, const char* cond,
+                             fmt::string_view fmt, fmt::format_args args);
+
+  // Whether any registered output subscribes to the severity. The console
+  // macros test this before formatting their arguments
+  static inline bool severity_enabled(int severity) {
+    return s_severity_mask.load(std::memory_order_relaxed) & severity;
+  }
+
+  // Milliseconds on the steady clock, wraps after ~49 days so only compare
+  // differences
+  static uint32_t clock_ms();
+
+  // Head of the list of every call site that has printed so far, walk it
+  // through ConsoleCallSite::next
+  static inline const ConsoleCallSite* call_sites() {
+    return s_call_sites.load(std::memory_order_acquire);
+  }
 
 public:
-  Console();
+  // Messages may be printed from any thread. Outputs are published as an
+  // immutable list, printing never takes a lock on the console, outputs
+  // serialize their own writes where they need to. Messages from one thread
+  // reach every output in the order they were printed.
+  //
+  // - opts: ConsoleFlag bits. Console_AsyncBit hands messages to a writer
+  //   thread through a bounded queue, the caller only encodes the arguments
+  //   and the writer formats the text. At most one Console_Overflow*Bit picks
+  //   what happens when it is full (defaults to blocking). Messages printed
+  //   on the writer thread itself, i.e. from inside an output, are written
+  //   right away as they could never be dequeued otherwise
+  // - async_capacity: Number of queued messages, rounded up to a power of two
+  Console(int opts = Console::s_DefaultOptions,
+          size_t async_capacity = Console::s_DefaultAsyncCapacity);
 
   void destroy();
 
+  // Blocks until every message queued before the call has been written and
+  // the outputs flushed, including the summaries of coalesced repeats and
+  // of rate limit windows that ended
+  void flush();
+  // Prints the summaries of coalesced repeats and of rate limited call sites
+  // whose rate window has ended, so a burst that stopped still gets
+  // reported. The async writer does this on its own, without it call this
+  // periodically, e.g. once per frame
+  void flush_expired_repeats();
+
+  // Takes ownership of the output. Adding and removing can happen while
+  // other threads print
   void add_output(ConsoleOutput* output);
 
   template <typename TConsoleOutput>
-  void add_output(uint32_t opts = ConsoleOutput::s_DefaultOptions |
-                                  ConsoleOutput::s_DefaultSeverity) {
-    add_output(new TConsoleOutput(opts));
+  TConsoleOutput* add_output(
+      uint32_t opts = ConsoleOutput::s_DefaultOptions |
+                      ConsoleOutput::s_DefaultSeverity) {
+    TConsoleOutput* output = new TConsoleOutput(opts);
+    add_output(output);
+    return output;
   }
 
+  // Stops sending messages to the output and prints its coalesced repeats.
+  // A thread may still be inside it, so it is only deleted by destroy()
+  void remove_output(ConsoleOutput* output);
+
+  inline int opts() const { return _opts; }
+
+private:
+  static std::atomic<int> s_severity_mask;
+  static std::atomic<const ConsoleCallSite*> s_call_sites;
+  static std::atomic<uint32_t> s_call_site_count;
+
+  static void _register_call_site(const ConsoleCallSite* site);
+
+  static bool _valid_options(int opts);
+
+  void _print(ConsoleMessage& msg, fmt::memory_buffer& text,
+              fmt::memory_buffer& data);
+  bool _rate_limited(const ConsoleOutputList& outputs,
+                     const ConsoleMessage& msg);
+  // Fills in what the outputs need, with defer_text the text is left to the
+  // async writer which formats it from the encoded arguments. Returns
+  // whether the text was formatted
+  bool _prepare_message(const ConsoleOutputList& outputs, ConsoleMessage& msg,
+                        fmt::memory_buffer& text, fmt::memory_buffer& data,
+                        bool defer_text);
+  void _write_to_outputs(const ConsoleOutputList& outputs,
+                         const ConsoleMessage& msg);
+  void _flush_outputs();
+  void _flush_repeats();
+  void _track_rate_limit(const ConsoleOutputList& outputs,
+                         const ConsoleMessage& msg);
+  // Reports the windows of tracked call sites that ended, or every window
+  // when all is set
+  void _flush_rate_windows(uint32_t now, bool all);
+  void _publish_outputs(ConsoleOutputList* outputs);
+  void _async_writer();
+
 private:
-  std::vector<ConsoleOutput*> _outputs;
+  int _opts                 = Console::s_DefaultOptions;
+  ConsoleAsyncQueue* _queue = nullptr;
+
+  // Replaced as a whole on every change. Lists and outputs that were
+  // replaced may still be read by a printing thread, they are kept until
+  // destroy()
+  std::atomic<const ConsoleOutputList*> _outputs = nullptr;
+  std::mutex _outputs_mutex;
+  std::vector<const ConsoleOutputList*> _retired_lists;
+  std::vector<ConsoleOutput*> _retired_outputs;
+
+  // Call sites that reached an output's rate limit in their current window
+  struct LimitedSite {
+    const ConsoleCallSite* site = nullptr;
+    uint32_t window_begin       = 0;
+    uint32_t window_hits        = 0;  // Set once the window ended
+    std::string text;  // Last message an output printed in the window
+  };
+  std::mutex _limited_mutex;
+  std::vector<LimitedSite> _limited;
 };
 
 #endif
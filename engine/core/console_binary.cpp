@@ -0,0 +1,402 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/console_binary.h"
+#include <algorithm>
+#include <cstring>
+#include <fmt/args.h>
+
+static constexpr uint16_t s_NullString = 0xffff;
+
+template <typename T>
+static void _append_raw(fmt::memory_buffer& out, T value) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  out.append(bytes, bytes + sizeof(T));
+}
+
+static void _append_arg_string(fmt::memory_buffer& out, fmt::string_view str) {
+  out.push_back((char)ConsoleBinaryArg_String);
+  _append_raw<uint32_t>(out, (uint32_t)str.size());
+  out.append(str.data(), str.data() + str.size());
+}
+
+static void _append_site_string(fmt::memory_buffer& out, fmt::string_view str) {
+  size_t size = std::min<size_t>(str.size(), s_NullString - 1);
+  _append_raw<uint16_t>(out, (uint16_t)size);
+  out.append(str.data(), str.data() + size);
+}
+
+static void _append_site_string(fmt::memory_buffer& out, const char* str) {
+  if (str == nullptr) {
+    _append_raw<uint16_t>(out, s_NullString);
+  } else {
+    _append_site_string(out, fmt::string_view(str));
+  }
+}
+
+template <typename T>
+static bool _read_raw(FILE* file, T& value) {
+  return std::fread(&value, sizeof(T), 1, file) == 1;
+}
+
+template <typename T>
+static bool _read_data(std::string_view data, size_t& offset, T& value) {
+  if (offset + sizeof(T) > data.size()) {
+    return false;
+  }
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  offset += sizeof(T);
+  return true;
+}
+
+struct ConsoleArgEncoder {
+  fmt::memory_buffer& out;
+  const fmt::basic_format_arg<fmt::format_context>& arg;
+  bool& exact;
+
+  void operator()(int val) {
+    out.push_back((char)ConsoleBinaryArg_Int);
+    _append_raw<int32_t>(out, val);
+  }
+  void operator()(unsigned val) {
+    out.push_back((char)ConsoleBinaryArg_UInt);
+    _append_raw<uint32_t>(out, val);
+  }
+  void operator()(long long val) {
+    out.push_back((char)ConsoleBinaryArg_LongLong);
+    _append_raw<int64_t>(out, val);
+  }
+  void operator()(unsigned long long val) {
+    out.push_back((char)ConsoleBinaryArg_ULongLong);
+    _append_raw<uint64_t>(out, val);
+  }
+  void operator()(bool val) {
+    out.push_back((char)ConsoleBinaryArg_Bool);
+    out.push_back((char)val);
+  }
+  void operator()(char val) {
+    out.push_back((char)ConsoleBinaryArg_Char);
+    out.push_back(val);
+  }
+  void operator()(float val) {
+    out.push_back((char)ConsoleBinaryArg_Float);
+    _append_raw<float>(out, val);
+  }
+  void operator()(double val) {
+    out.push_back((char)ConsoleBinaryArg_Double);
+    _append_raw<double>(out, val);
+  }
+  void operator()(long double val) { (*this)((double)val); }
+  void operator()(const char* val) {
+    _append_arg_string(out, val != nullptr ? val : "");
+  }
+  void operator()(fmt::string_view val) { _append_arg_string(out, val); }
+  void operator()(const void* val) {
+    out.push_back((char)ConsoleBinaryArg_Pointer);
+    _append_raw<uint64_t>(out, (uint64_t)(uintptr_t)val);
+  }
+
+  // Custom formatters and 128-bit integers, keep their text
+  template <typename T>
+  void operator()(T) {
+    exact = false;
+    fmt::basic_format_arg<fmt::format_context> single[] = {arg};
+    fmt::memory_buffer text;
+    fmt::vformat_to(fmt::appender(text), "{}", fmt::format_args(single, 1));
+    _append_arg_string(out, fmt::string_view(text.data(), text.size()));
+  }
+};
+
+bool console_encode_args(fmt::memory_buffer& out, fmt::format_args args) {
+  bool exact = true;
+  for (int i = 0;; i++) {
+    fmt::basic_format_arg<fmt::format_context> arg = args.get(i);
+    if (!arg) {
+      break;
+    }
+    arg.visit(ConsoleArgEncoder {out, arg, exact});
+  }
+  return exact;
+}
+
+bool console_decode_args(
+    std::string_view data,
+    fmt::dynamic_format_arg_store<fmt::format_context>& store) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    uint8_t type = (uint8_t)data[offset++];
+    bool read    = false;
+    switch (type) {
+    case ConsoleBinaryArg_Int: {
+      int32_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val);
+      }
+    } break;
+    case ConsoleBinaryArg_UInt: {
+      uint32_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val);
+      }
+    } break;
+    case ConsoleBinaryArg_LongLong: {
+      int64_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back((long long)val);
+      }
+    } break;
+    case ConsoleBinaryArg_ULongLong: {
+      uint64_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back((unsigned long long)val);
+      }
+    } break;
+    case ConsoleBinaryArg_Bool: {
+      uint8_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val != 0);
+      }
+    } break;
+    case ConsoleBinaryArg_Char: {
+      char val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val);
+      }
+    } break;
+    case ConsoleBinaryArg_Float: {
+      float val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val);
+      }
+    } break;
+    case ConsoleBinaryArg_Double: {
+      double val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back(val);
+      }
+    } break;
+    case ConsoleBinaryArg_String: {
+      uint32_t length;
+      read = _read_data(data, offset, length) &&
+             offset + length <= data.size();
+      if (read) {
+        // Views into data, which has to outlive the formatting
+        store.push_back(fmt::string_view(data.data() + offset, length));
+        offset += length;
+      }
+    } break;
+    case ConsoleBinaryArg_Pointer: {
+      uint64_t val;
+      if ((read = _read_data(data, offset, val))) {
+        store.push_back((const void*)(uintptr_t)val);
+      }
+    } break;
+    default:
+      break;
+    }
+    if (!read) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ConsoleBinaryOutput::ConsoleBinaryOutput(const std::string_view& path,
+                                         int opts)
+      : ConsoleOutput(opts | ConsoleOutput_DeferredFormatBit) {
+  std::string path_str(path);
+  _file = std::fopen(path_str.c_str(), "wb");
+  if (_file == nullptr) {
+    CONTEXT_ERROR("CONSOLE", "Failed to open binary output '{}'", path);
+    return;
+  }
+
+  ConsoleBinaryHeader header;
+  header.opts = _opts & ~ConsoleOutput_DeferredFormatBit;
+  std::fwrite(&header, sizeof(header), 1, _file);
+}
+
+ConsoleBinaryOutput::~ConsoleBinaryOutput() {
+  if (_file != nullptr) {
+    std::fclose(_file);
+  }
+}
+
+void ConsoleBinaryOutput::print_output(const ConsoleMessage& msg) {
+  if (_file == nullptr) {
+    return;
+  }
+
+  // The site table and the record buffer are shared between threads
+  std::lock_guard<std::mutex> lock(_mutex);
+  _record.clear();
+  uint32_t id = msg.site->id.load(std::memory_order_relaxed);
+  if (id >= _described.size() || !_described[id]) {
+    _describe_site(msg);
+  }
+  _record.push_back((char)ConsoleBinaryRecord_Message);
+  _append_raw<uint32_t>(_record, id);
+  _append_raw<uint32_t>(_record, (uint32_t)msg.data.size());
+  _record.append(msg.data.data(), msg.data.data() + msg.data.size());
+  std::fwrite(_record.data(), 1, _record.size(), _file);
+
+  if (_opts & ConsoleOutput_FlushPerMessageBit) {
+    std::fflush(_file);
+  }
+}
+
+void ConsoleBinaryOutput::flush() {
+  if (_file != nullptr) {
+    std::fflush(_file);
+  }
+}
+
+void ConsoleBinaryOutput::_describe_site(const ConsoleMessage& msg) {
+  const ConsoleCallSite* site = msg.site;
+  uint32_t id                 = site->id.load(std::memory_order_relaxed);
+  if (id >= _described.size()) {
+    _described.resize(id + 1, false);
+  }
+  _described[id] = true;
+
+  _record.push_back((char)ConsoleBinaryRecord_Site);
+  _append_raw<uint32_t>(_record, id);
+  _append_raw<int32_t>(_record, site->line);
+  _append_raw<int32_t>(_record, site->severity);
+  _append_site_string(_record, site->file);
+  _append_site_string(_record, site->fn);
+  _append_site_string(_record, site->ctx);
+  _append_site_string(_record, site->cond);
+  _append_site_string(_record, msg.fmt);
+}
+
+ConsoleBinaryReader::ConsoleBinaryReader(const std::string_view& path) {
+  std::string path_str(path);
+  _file = std::fopen(path_str.c_str(), "rb");
+  if (_file == nullptr) {
+    CONTEXT_ERROR("CONSOLE", "Failed to open binary stream '{}'", path);
+    return;
+  }
+
+  bool valid = _read_raw(_file, _header) &&
+               _header.magic == ConsoleBinaryHeader::s_Magic &&
+               _header.version == ConsoleBinaryHeader::s_Version;
+  if (!valid) {
+    CONTEXT_ERROR("CONSOLE", "'{}' is not a binary console stream", path);
+    std::fclose(_file);
+    _file = nullptr;
+  }
+}
+
+ConsoleBinaryReader::~ConsoleBinaryReader() {
+  if (_file != nullptr) {
+    std::fclose(_file);
+  }
+}
+
+bool ConsoleBinaryReader::next(ConsoleMessage& msg) {
+  if (_file == nullptr) {
+    return false;
+  }
+
+  uint8_t tag = 0;
+  while (_read_raw(_file, tag)) {
+    if (tag == ConsoleBinaryRecord_Site) {
+      if (!_read_site()) {
+        return false;
+      }
+      continue;
+    }
+    if (tag != ConsoleBinaryRecord_Message) {
+      CONTEXT_ERROR("CONSOLE", "Unknown binary record {}", tag);
+      return false;
+    }
+
+    uint32_t id = 0, size = 0;
+    if (!_read_raw(_file, id) || !_read_raw(_file, size)) {
+      return false;
+    }
+    auto site = _sites.find(id);
+    if (site == _sites.end()) {
+      CONTEXT_ERROR("CONSOLE", "Binary message from undescribed site {}", id);
+      return false;
+    }
+    _data.resize(size);
+    if (size > 0 && std::fread(_data.data(), 1, size, _file) != size) {
+      return false;
+    }
+
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    if (!console_decode_args(_data, store)) {
+      CONTEXT_ERROR("CONSOLE", "Malformed arguments in binary message");
+      return false;
+    }
+
+    msg.site     = site->second.call_site.get();
+    msg.severity = msg.site->severity;
+    msg.fmt      = site->second.fmt;
+    msg.args     = fmt::format_args();
+    Console::format_message(_text, msg.site->cond, msg.fmt, store);
+    msg.msg      = std::string_view(_text.data(), _text.size());
+    msg.data     = std::string_view(_data);
+    msg.has_msg  = true;
+    msg.has_data = true;
+    return true;
+  }
+  return false;
+}
+
+bool ConsoleBinaryReader::_read_site() {
+  uint32_t id = 0;
+  int32_t line = -1, severity = ConsoleOutput_NoneBit;
+  bool has_ctx = false, has_cond = false;
+  Site site;
+  bool read = _read_raw(_file, id) && _read_raw(_file, line) &&
+              _read_raw(_file, severity) &&
+              _read_string(site.file, nullptr) &&
+              _read_string(site.fn, nullptr) &&
+              _read_string(site.ctx, &has_ctx) &&
+              _read_string(site.cond, &has_cond) &&
+              _read_string(site.fmt, nullptr);
+  if (!read) {
+    CONTEXT_ERROR("CONSOLE", "Malformed call site in binary stream");
+    return false;
+  }
+
+  // Map nodes are stable, so the call site can point into the strings
+  Site& stored     = _sites[id];
+  stored           = std::move(site);
+  stored.call_site = std::make_unique<ConsoleCallSite>(
+      line, stored.file.c_str(), stored.fn.c_str(),
+      has_ctx ? stored.ctx.c_str() : nullptr,
+      has_cond ? stored.cond.c_str() : nullptr, severity);
+  return true;
+}
+
+bool ConsoleBinaryReader::_read_string(std::string& out, bool* present) {
+  uint16_t size = 0;
+  if (!_read_raw(_file, size)) {
+    return false;
+  }
+  if (present != nullptr) {
+    *present = size != s_NullString;
+  }
+  if (size == s_NullString) {
+    out.clear();
+    return true;
+  }
+  out.resize(size);
+  return size == 0 || std::fread(out.data(), 1, size, _file) == size;
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_CONSOLE_BINARY_H
+#define CORE_CONSOLE_BINARY_H
+
+#include "core/console.h"
+#include <cstdint>
+#include <cstdio>
+#include <fmt/args.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Deferred binary console stream
+//
+// The stream starts with a ConsoleBinaryHeader, followed by records that
+// start with a ConsoleBinaryRecord tag byte. A call site is described once by
+// a Site record (ConsoleCallSite::id, line, severity, file, function,
+// context, condition and format string), every message after that is only a
+// Message record holding the site id and the encoded arguments. Integers use
+// host byte order and strings are a u16 length followed by the bytes, 0xffff
+// marks a null string.
+//
+// Arguments are encoded as a ConsoleBinaryArg tag followed by the raw value.
+// Types that fmt only knows through a custom formatter are formatted at the
+// call site and stored as a string.
+
+enum ConsoleBinaryRecord : uint8_t {
+  ConsoleBinaryRecord_Site    = 1,
+  ConsoleBinaryRecord_Message = 2,
+};
+
+enum ConsoleBinaryArg : uint8_t {
+  ConsoleBinaryArg_Int       = 1,  // i32
+  ConsoleBinaryArg_UInt      = 2,  // u32
+  ConsoleBinaryArg_LongLong  = 3,  // i64
+  ConsoleBinaryArg_ULongLong = 4,  // u64
+  ConsoleBinaryArg_Bool      = 5,  // u8
+  ConsoleBinaryArg_Char      = 6,  // u8
+  ConsoleBinaryArg_Float     = 7,  // f32
+  ConsoleBinaryArg_Double    = 8,  // f64, long double is narrowed
+  ConsoleBinaryArg_String    = 9,  // u32 length + bytes
+  ConsoleBinaryArg_Pointer   = 10, // u64
+};
+
+struct ConsoleBinaryHeader {
+  static constexpr uint32_t s_Magic   = 0x474c5746;  // "FWLG"
+  static constexpr uint32_t s_Version = 1;
+
+  uint32_t magic   = s_Magic;
+  uint32_t version = s_Version;
+  int32_t opts     = ConsoleOutput_NoneBit;  // Text options to decode with
+};
+
+// Appends the arguments to out in the ConsoleBinaryArg encoding. Returns
+// false when an argument was only kept as its text, a format spec written for
+// its type may not apply to the decoded string
+bool console_encode_args(fmt::memory_buffer& out, fmt::format_args args);
+// Reads arguments encoded by console_encode_args, false when data is malformed.
+// Strings are pushed as views into data, which has to outlive the store
+bool console_decode_args(
+    std::string_view data,
+    fmt::dynamic_format_arg_store<fmt::format_context>& store);
+
+class ConsoleBinaryOutput : public ConsoleOutput {
+public:
+  static constexpr int s_DefaultOptions =
+      (ConsoleOutput::s_DefaultOptions & ~ConsoleOutput_FlushPerMessageBit) |
+      ConsoleOutput::s_DefaultSeverity;
+
+public:
+  // - path: File the stream is written to, truncated if it exists
+  // - opts: Severity bits select the messages, the formatting bits are stored
+  //   in the header so the decoder reproduces the text of a terminal output
+  //   created with the same options
+  ConsoleBinaryOutput(const std::string_view& path,
+                      int opts = ConsoleBinaryOutput::s_DefaultOptions);
+  ~ConsoleBinaryOutput() override;
+
+  inline std::string_view name() const override {
+    return "Binary Stream Output";
+  }
+  void print_output(const ConsoleMessage& msg) override;
+  void flush() override;
+
+private:
+  void _describe_site(const ConsoleMessage& msg);
+
+private:
+  FILE* _file = nullptr;
+  std::mutex _mutex;
+  fmt::memory_buffer _record;
+  std::vector<bool> _described;  // Indexed by ConsoleCallSite::id
+};
+
+// Reads a stream written by ConsoleBinaryOutput back into messages with the
+// same text a regular output would have formatted
+class ConsoleBinaryReader {
+public:
+  ConsoleBinaryReader(const std::string_view& path);
+  ~ConsoleBinaryReader();
+
+  inline bool valid() const { return _file != nullptr; }
+  inline int opts() const { return _header.opts; }
+
+  // Reads the next message, returns false at the end of the stream or when
+  // the stream is malformed. The message stays valid until the next call
+  bool next(ConsoleMessage& msg);
+
+private:
+  struct Site {
+    std::string file;
+    std::string fn;
+    std::string ctx;
+    std::string cond;
+    std::string fmt;
+    std::unique_ptr<ConsoleCallSite> call_site;
+  };
+
+  bool _read_site();
+  bool _read_string(std::string& out, bool* present);
+
+private:
+  FILE* _file = nullptr;
+  ConsoleBinaryHeader _header;
+  std::unordered_map<uint32_t, Site> _sites;
+  std::string _data;
+  fmt::memory_buffer _text;
+};
+
+#endif
@@ -0,0 +1,269 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/console_file.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+// Errors happen under the output lock or while the console deletes its
+// outputs, a console message from here would come back into the output
+template <typename... TArgs>
+static void _report_error(fmt::format_string<TArgs...> fmt, TArgs&&... args) {
+  fmt::print(stderr, "Error [CONSOLE] ");
+  fmt::println(stderr, fmt, std::forward<TArgs>(args)...);
+}
+
+ConsoleFileOutput::ConsoleFileOutput(const std::string_view& path,
+                                     const ConsoleFileConfig& config, int opts)
+      : ConsoleOutput(opts), _path(path), _config(config) {
+  _open();
+}
+
+ConsoleFileOutput::~ConsoleFileOutput() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _close();
+}
+
+void ConsoleFileOutput::print_output(const ConsoleMessage& msg) {
+  std::string_view text = _format(msg);
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_data == nullptr) {
+    return;
+  }
+
+  auto now        = std::chrono::steady_clock::now();
+  bool rotate_now = _offset + text.size() > _size;
+  if (_config.rotate_interval.count() > 0) {
+    rotate_now |= now - _opened >= _config.rotate_interval;
+  }
+  if (_offset > 0 && rotate_now) {
+    _rotate();
+    if (_data == nullptr) {
+      return;
+    }
+  }
+
+  // A message larger than the whole file is cut off, the first byte goes in
+  // last so a partially copied message is never seen as complete
+  size_t size = std::min(text.size(), _size - _offset);
+  char* dst   = _data + _offset;
+  std::memcpy(dst + 1, text.data() + 1, size - 1);
+  std::atomic_signal_fence(std::memory_order_release);
+  dst[0] = text[0];
+  _offset += size;
+
+  // Only the severities that ask for it wait on the disk, the logging thread
+  // should not block on I/O every sync_interval
+  if (msg.severity & _config.sync_severity) {
+    _sync(true);
+  } else if ((_opts & ConsoleOutput_FlushPerMessageBit) ||
+             now - _last_sync >= _config.sync_interval) {
+    _sync(false);
+  }
+}
+
+void ConsoleFileOutput::flush() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _sync(false);
+}
+
+void ConsoleFileOutput::rotate() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _rotate();
+}
+
+void ConsoleFileOutput::_rotate() {
+  _close();
+
+  namespace fs = std::filesystem;
+  std::error_code error;
+  if (_config.max_rotated_files == 0) {
+    fs::remove(_path, error);
+  } else {
+    for (uint32_t i = _config.max_rotated_files - 1; i > 0; i--) {
+      fs::path from = fmt::format("{}.{}", _path, i);
+      if (fs::exists(from, error)) {
+        fs::rename(from, fmt::format("{}.{}", _path, i + 1), error);
+      }
+    }
+    fs::rename(_path, _path + ".1", error);
+  }
+  if (error) {
+    _report_error("Failed to rotate '{}': {}", _path, error.message());
+  }
+
+  _open();
+}
+
+#ifdef _WIN32
+
+bool ConsoleFileOutput::_open() {
+  _size      = _config.file_size;
+  _offset    = 0;
+  _synced    = 0;
+  _scheduled = 0;
+
+  HANDLE file = CreateFileA(_path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    _report_error("Failed to open file output '{}'", _path);
+    return false;
+  }
+
+  // Creating the mapping grows the file to its full size
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                         (DWORD)((uint64_t)_size >> 32), (DWORD)_size, nullptr);
+  void* data = mapping != nullptr
+                   ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, _size)
+                   : nullptr;
+  if (data == nullptr) {
+    _report_error("Failed to map file output '{}'", _path);
+    if (mapping != nullptr) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return false;
+  }
+
+  _handle    = (intptr_t)file;
+  _mapping   = (intptr_t)mapping;
+  _data      = (char*)data;
+  _opened    = std::chrono::steady_clock::now();
+  _last_sync = _opened;
+  return true;
+}
+
+void ConsoleFileOutput::_close() {
+  if (_data == nullptr) {
+    return;
+  }
+  _sync(true);
+  UnmapViewOfFile(_data);
+  CloseHandle((HANDLE)_mapping);
+
+  LARGE_INTEGER end;
+  end.QuadPart = (LONGLONG)_offset;
+  SetFilePointerEx((HANDLE)_handle, end, nullptr, FILE_BEGIN);
+  SetEndOfFile((HANDLE)_handle);
+  CloseHandle((HANDLE)_handle);
+
+  _data    = nullptr;
+  _handle  = -1;
+  _mapping = 0;
+}
+
+void ConsoleFileOutput::_sync(bool blocking) {
+  size_t from = blocking ? _synced : _scheduled;
+  if (_data == nullptr || from == _offset) {
+    return;
+  }
+  FlushViewOfFile(_data + from, _offset - from);
+  if (blocking) {
+    FlushFileBuffers((HANDLE)_handle);
+    _synced = _offset;
+  }
+  _scheduled = _offset;
+  _last_sync = std::chrono::steady_clock::now();
+}
+
+#else
+
+bool ConsoleFileOutput::_open() {
+  _size      = _config.file_size;
+  _offset    = 0;
+  _synced    = 0;
+  _scheduled = 0;
+
+  int fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    _report_error("Failed to open file output '{}': {}", _path,
+                  std::strerror(errno));
+    return false;
+  }
+
+  void* data = MAP_FAILED;
+  if (::ftruncate(fd, (off_t)_size) == 0) {
+    data = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (data == MAP_FAILED) {
+    _report_error("Failed to map file output '{}': {}", _path,
+                  std::strerror(errno));
+    ::close(fd);
+    return false;
+  }
+
+  _handle    = fd;
+  _data      = (char*)data;
+  _opened    = std::chrono::steady_clock::now();
+  _last_sync = _opened;
+  return true;
+}
+
+void ConsoleFileOutput::_close() {
+  if (_data == nullptr) {
+    return;
+  }
+  _sync(true);
+  ::munmap(_data, _size);
+  if (::ftruncate((int)_handle, (off_t)_offset) != 0) {
+    _report_error("Failed to truncate file output '{}'", _path);
+  }
+  ::close((int)_handle);
+
+  _data   = nullptr;
+  _handle = -1;
+}
+
+void ConsoleFileOutput::_sync(bool blocking) {
+  size_t from = blocking ? _synced : _scheduled;
+  if (_data == nullptr || from == _offset) {
+    return;
+  }
+
+  // msync wants a page aligned start
+  static const size_t s_page_size = (size_t)::sysconf(_SC_PAGESIZE);
+  size_t begin                    = from & ~(s_page_size - 1);
+  if (blocking) {
+    ::msync(_data + begin, _offset - begin, MS_SYNC);
+    _synced = _offset;
+  } else {
+#ifdef __linux__
+    // MS_ASYNC does nothing on Linux, this starts writeback of the dirty
+    // pages without waiting on it
+    ::sync_file_range((int)_handle, (off_t)begin, (off_t)(_offset - begin),
+                      SYNC_FILE_RANGE_WRITE);
+#else
+    ::msync(_data + begin, _offset - begin, MS_ASYNC);
+#endif
+  }
+  _scheduled = _offset;
+  _last_sync = std::chrono::steady_clock::now();
+}
+
+#endif
@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_CONSOLE_FILE_H
+#define CORE_CONSOLE_FILE_H
+
+#include "core/console.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct ConsoleFileConfig {
+  // Size the file is created with, a message that does not fit in the
+  // remaining space rotates the file
+  size_t file_size = 4 * 1024 * 1024;
+  // Rotated files are kept as <path>.1 (newest) up to <path>.N (oldest)
+  uint32_t max_rotated_files = 4;
+  // Rotate after this much time, zero only rotates by size
+  std::chrono::seconds rotate_interval = std::chrono::seconds(0);
+
+  // Messages with these severities are synced to disk before print returns,
+  // for everything else writeback is started without waiting on it at most
+  // once per sync_interval
+  int sync_severity = ConsoleOutput_SeverityErrorBit |
+                      ConsoleOutput_SeverityFatalBit;
+  std::chrono::milliseconds sync_interval = std::chrono::milliseconds(1000);
+};
+
+// Writes text messages into a pre-sized memory mapped file, so a message is a
+// copy into the page cache instead of a write call.
+//
+// Unused space in the file is zero filled. The first byte of a message is
+// stored after the rest of it, so a crash mid message leaves a zero where the
+// message starts and the log ends at the last complete message. The file is
+// truncated to its written size when it is rotated or closed.
+//
+// Messages are formatted outside of the lock, only the copy into the mapping
+// and the syncs are serialized.
+class ConsoleFileOutput : public ConsoleOutput {
+public:
+  static constexpr int s_DefaultOptions =
+      (ConsoleOutput::s_DefaultOptions & ~(ConsoleOutput_FlushPerMessageBit |
+                                           ConsoleOutput_ColorBit)) |
+      ConsoleOutput::s_DefaultSeverity;
+
+public:
+  // - path: File the messages are written to, truncated if it exists
+  // - config: Size, rotation and sync behaviour
+  // - opts: Same as ConsoleTerminalOutput, FlushPerMessageBit syncs every
+  //   message
+  ConsoleFileOutput(const std::string_view& path,
+                    const ConsoleFileConfig& config = ConsoleFileConfig(),
+                    int opts = ConsoleFileOutput::s_DefaultOptions);
+  ~ConsoleFileOutput() override;
+
+  inline std::string_view name() const override { return "File Output"; }
+  inline bool valid() const { return _data != nullptr; }
+  void print_output(const ConsoleMessage& msg) override;
+  void flush() override;
+
+  // Rotates now, the current file becomes <path>.1
+  void rotate();
+
+private:
+  bool _open();
+  void _close();
+  void _rotate();
+  void _sync(bool blocking);
+
+private:
+  std::string _path;
+  ConsoleFileConfig _config;
+  std::mutex _mutex;
+
+  char* _data        = nullptr;
+  size_t _size       = 0;
+  size_t _offset     = 0;
+  size_t _synced     = 0;  // Everything before this offset is on disk
+  size_t _scheduled  = 0;  // Writeback was started up to this offset
+  intptr_t _handle   = -1; // File descriptor or HANDLE
+  intptr_t _mapping  = 0;  // Mapping HANDLE on Windows
+  std::chrono::steady_clock::time_point _opened;
+  std::chrono::steady_clock::time_point _last_sync;
+};
+
+#endif
@@ -0,0 +1,59 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/console_ring.h"
+
+ConsoleRingOutput::ConsoleRingOutput(int opts, size_t capacity)
+      : ConsoleOutput(opts) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  _entries.resize(size);
+  _mask = size - 1;
+  _contexts.emplace_back();
+}
+
+void ConsoleRingOutput::print_output(const ConsoleMessage& msg) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  ConsoleRingEntry& entry = _entries[_end & _mask];
+  entry.sequence          = _end++;
+  entry.severity          = msg.severity;
+  entry.site              = msg.site;
+  entry.context           = _intern_context(msg.site->ctx);
+  entry.text.assign(msg.msg);
+}
+
+uint32_t ConsoleRingOutput::_intern_context(const char* ctx) {
+  if (ctx == nullptr) {
+    return 0;
+  }
+
+  // Contexts are almost always literals, so the pointer is a cheap first key
+  // and the string compare only runs once per distinct literal
+  auto ptr = _context_ptrs.find(ctx);
+  if (ptr != _context_ptrs.end()) {
+    return ptr->second;
+  }
+
+  uint32_t index = 1;
+  while (index < _contexts.size() && _contexts[index] != ctx) {
+    index++;
+  }
+  if (index == _contexts.size()) {
+    _contexts.emplace_back(ctx);
+  }
+  _context_ptrs.emplace(ctx, index);
+  return index;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_CONSOLE_RING_H
+#define CORE_CONSOLE_RING_H
+
+#include "core/console.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct ConsoleRingEntry {
+  uint64_t sequence           = 0;
+  int severity                = ConsoleOutput_NoneBit;
+  uint32_t context            = 0;  // Index into ConsoleRingOutput::contexts
+  const ConsoleCallSite* site = nullptr;
+  std::string text;  // Message text without head and call site info
+};
+
+// Keeps the last capacity messages in memory for in-engine log viewers.
+//
+// Every message gets a sequence number, the ring holds [begin_sequence(),
+// end_sequence()). Entries are reused in place, so once the ring has wrapped
+// and the text capacities have grown, storing a message does not allocate.
+// Contexts are interned on arrival so viewers can filter by index instead of
+// comparing strings.
+class ConsoleRingOutput : public ConsoleOutput {
+public:
+  static constexpr int s_DefaultOptions     = ConsoleOutput::s_SeverityMask;
+  static constexpr size_t s_DefaultCapacity = 1 << 16;
+
+public:
+  // - opts: Severity bits of the messages to keep
+  // - capacity: Number of messages kept, rounded up to a power of two
+  ConsoleRingOutput(int opts = ConsoleRingOutput::s_DefaultOptions,
+                    size_t capacity = ConsoleRingOutput::s_DefaultCapacity);
+
+  inline std::string_view name() const override { return "Ring Output"; }
+  void print_output(const ConsoleMessage& msg) override;
+
+  // Everything below must be called with the lock held
+  inline std::unique_lock<std::mutex> lock() {
+    return std::unique_lock<std::mutex>(_mutex);
+  }
+
+  inline uint64_t begin_sequence() const {
+    return _end > _entries.size() ? _end - _entries.size() : 0;
+  }
+  inline uint64_t end_sequence() const { return _end; }
+  inline const ConsoleRingEntry& entry(uint64_t sequence) const {
+    return _entries[sequence & _mask];
+  }
+
+  // Index 0 is the empty context of messages without one
+  inline const std::vector<std::string>& contexts() const {
+    return _contexts;
+  }
+
+private:
+  uint32_t _intern_context(const char* ctx);
+
+private:
+  std::mutex _mutex;
+  std::vector<ConsoleRingEntry> _entries;
+  uint64_t _mask = 0;
+  uint64_t _end  = 0;
+
+  std::vector<std::string> _contexts;
+  std::unordered_map<const char*, uint32_t> _context_ptrs;
+};
+
+#endif
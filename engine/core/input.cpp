@@ -14,67 +14,176 @@
 
 #include "core/input.h"
 #include "core/console.h"
+#include <algorithm>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 static Input* s_instance = nullptr;
 
-#define KY_REG_ONCE_IMPL(func, input_type, code, pressed)                      \
-  bool result = func(code);                                                    \
-  if (result) {                                                                \
-    result = s_instance->_register_once(input_type, code, pressed);            \
-  }                                                                            \
-  return result
+// Puts the previous callback back unless another one was chained after ours,
+// that one still calls ours and has to stay installed
+template <typename TCallback>
+static void _restore_callback(TCallback (*set)(GLFWwindow*, TCallback),
+                              GLFWwindow* window, TCallback ours,
+                              TCallback previous) {
+  TCallback current = set(window, previous);
+  if (current != ours) {
+    set(window, current);
+  }
+}
 
-#define KY_REG_ONCE_WITH_HANDLE_IMPL(func, handle, input_type, code, pressed)  \
-  bool result = func(handle, code);                                            \
-  if (result) {                                                                \
-    result = s_instance->_register_once(input_type, code, pressed);            \
-  }                                                                            \
-  return result
+static inline bool _valid_key(KeyCode code) {
+  return code >= 0 && code <= KeyCode_Last;
+}
+
+static inline bool _valid_button(MouseButton button) {
+  return button >= 0 && button <= MouseButton_Last;
+}
 
 Input::Input(WindowHandle* window) {
-  s_instance              = this;
-  s_instance->_window_ptr = window;
-  for (RegisteredInput& reg : s_instance->_reg_buffer) {
-    reg.type = InputType::Unknown;
+  s_instance  = this;
+  _window_ptr = window;
+
+  GLFWwindow* handle = window->handle_ptr();
+  _prev_key_callback = glfwSetKeyCallback(handle, _key_callback);
+  _prev_mouse_button_callback =
+      glfwSetMouseButtonCallback(handle, _mouse_button_callback);
+  _prev_char_callback = glfwSetCharCallback(handle, _char_callback);
+  _prev_cursor_pos_callback =
+      glfwSetCursorPosCallback(handle, _cursor_pos_callback);
+  _prev_scroll_callback = glfwSetScrollCallback(handle, _scroll_callback);
+
+  double x = 0.0;
+  double y = 0.0;
+  glfwGetCursorPos(handle, &x, &y);
+  _cursor = glm::vec2((float)x, (float)y);
+}
+
+Input::~Input() {
+  stop_recording();
+
+  // The window may already be gone, taking its callbacks with it
+  GLFWwindow* handle = _window_ptr->handle_ptr();
+  if (handle != nullptr) {
+    _restore_callback(glfwSetKeyCallback, handle, _key_callback,
+                      _prev_key_callback);
+    _restore_callback(glfwSetMouseButtonCallback, handle,
+                      _mouse_button_callback, _prev_mouse_button_callback);
+    _restore_callback(glfwSetCharCallback, handle, _char_callback,
+                      _prev_char_callback);
+    _restore_callback(glfwSetCursorPosCallback, handle, _cursor_pos_callback,
+                      _prev_cursor_pos_callback);
+    _restore_callback(glfwSetScrollCallback, handle, _scroll_callback,
+                      _prev_scroll_callback);
+  }
+  if (s_instance == this) {
+    s_instance = nullptr;
   }
 }
 
 bool Input::key_pressed(KeyCode code) {
-  KY_REG_ONCE_IMPL(key_press, InputType::Keyboard, code, true);
+  return _valid_key(code) && s_instance->_keys_pressed[code];
 }
 
 bool Input::key_released(KeyCode code) {
-  KY_REG_ONCE_IMPL(key_release, InputType::Keyboard, code, false);
+  return _valid_key(code) && s_instance->_keys_released[code];
 }
 
 bool Input::key_press(KeyCode code) {
-  return glfwGetKey(s_instance->_window_ptr->handle_ptr(), code) == GLFW_PRESS;
+  return _valid_key(code) && s_instance->_keys_down[code];
 }
 
 bool Input::key_release(KeyCode code) {
-  return glfwGetKey(s_instance->_window_ptr->handle_ptr(), code) ==
-         GLFW_RELEASE;
+  return _valid_key(code) && !s_instance->_keys_down[code];
 }
 
 bool Input::mouse_pressed(MouseButton button) {
-  KY_REG_ONCE_IMPL(mouse_press, InputType::Mouse, button, true);
+  return _valid_button(button) && s_instance->_mouse_pressed[button];
 }
 
 bool Input::mouse_released(MouseButton button) {
-  KY_REG_ONCE_IMPL(mouse_release, InputType::Mouse, button, false);
+  return _valid_button(button) && s_instance->_mouse_released[button];
 }
 
 bool Input::mouse_press(MouseButton button) {
-  return glfwGetMouseButton(s_instance->_window_ptr->handle_ptr(), button) ==
-         GLFW_PRESS;
+  return _valid_button(button) && s_instance->_mouse_down[button];
 }
 
 bool Input::mouse_release(MouseButton button) {
-  return glfwGetMouseButton(s_instance->_window_ptr->handle_ptr(), button) ==
-         GLFW_RELEASE;
+  return _valid_button(button) && !s_instance->_mouse_down[button];
+}
+
+glm::vec2 Input::mouse_position() {
+  return s_instance->_cursor;
+}
+
+glm::vec2 Input::mouse_scroll() {
+  return s_instance->_scroll;
+}
+
+int Input::key_mods() {
+  return s_instance->_mods;
+}
+
+const InputGamepads& Input::gamepads() {
+  return s_instance->_gamepads;
+}
+
+InputGamepadConfig& Input::gamepad_config() {
+  return s_instance->_gamepads.config();
+}
+
+bool Input::gamepad_connected(GamepadJoystick joystick) {
+  return s_instance->_gamepads.connected(joystick);
+}
+
+float Input::gamepad_axis(GamepadJoystick joystick, GamepadAxis axis) {
+  return s_instance->_gamepads.axis(joystick, axis);
+}
+
+bool Input::gamepad_pressed(GamepadJoystick joystick, GamepadButton button) {
+  return s_instance->_gamepads.pressed(joystick, button);
+}
+
+bool Input::gamepad_released(GamepadJoystick joystick, GamepadButton button) {
+  return s_instance->_gamepads.released(joystick, button);
+}
+
+bool Input::gamepad_press(GamepadJoystick joystick, GamepadButton button) {
+  return s_instance->_gamepads.press(joystick, button);
+}
+
+InputActionMap& Input::action_map() {
+  return s_instance->_actions;
+}
+
+bool Input::action_pressed(InputAction action) {
+  return s_instance->_actions.pressed(action);
+}
+
+bool Input::action_released(InputAction action) {
+  return s_instance->_actions.released(action);
+}
+
+bool Input::action_press(InputAction action) {
+  return s_instance->_actions.down(action);
+}
+
+uint32_t Input::frame() {
+  return s_instance->_frame;
+}
+
+InputTextBuffer& Input::text() {
+  return s_instance->_text;
+}
+
+const InputLatency& Input::latency() {
+  return s_instance->_latency;
+}
+
+InputEventQueue* Input::event_queue() {
+  return s_instance->_event_queue.get();
 }
 
 std::string_view Input::type_to_string(InputType type) {
@@ -104,51 +213,331 @@ std::string_view Input::mouse_mode_to_string(MouseMode mode) {
 }
 
 void Input::poll_events() {
+  _text.discard_before(_frame);
+  _resolve_latency();
+  pump_events();
+
+  if (_replay != nullptr) {
+    _gamepads.begin_frame();
+    _replay_frame();
+  } else {
+    _gamepads.poll();
+    _emit_gamepad_buttons();
+    _emit_gamepad_axes();
+  }
+
+  // Edges from every pump since the last frame, the previous frame has
+  // consumed its own by now
+  _keys_pressed   = _keys_pressed_pending;
+  _keys_released  = _keys_released_pending;
+  _mouse_pressed  = _mouse_pressed_pending;
+  _mouse_released = _mouse_released_pending;
+  _keys_pressed_pending.reset();
+  _keys_released_pending.reset();
+  _mouse_pressed_pending.reset();
+  _mouse_released_pending.reset();
+  _scroll         = _scroll_pending;
+  _scroll_pending = glm::vec2(0.0f);
+
+  // A press released again before this frame still reaches the actions
+  _gamepads.process();
+  _actions.update(_keys_down | _keys_pressed, _mouse_down | _mouse_pressed,
+                  _gamepads.any_down(), _mods);
+  _frame++;
+}
+
+void Input::pump_events() {
+  // Still pumped while replaying so the window keeps responding, the device
+  // callbacks drop their events
   glfwPollEvents();
-  size_t reg_counted = 0;
-  for (RegisteredInput& reg : s_instance->_reg_buffer) {
-    if (reg_counted == s_instance->_reg_active_count) {
-      break;
-    } else if (reg.type == InputType::Unknown) {
-      continue;
+}
+
+void Input::set_event_queue(bool enabled) {
+  if (!enabled) {
+    _event_queue.reset();
+  } else if (_event_queue == nullptr) {
+    _event_queue = std::make_unique<InputEventQueue>();
+  }
+}
+
+bool Input::start_recording(const std::string_view& path) {
+  CONTEXT_CONDITION_ERROR_RETURN("INPUT", _replay == nullptr, false,
+                                 "Cannot record while replaying");
+  stop_recording();
+  std::unique_ptr<InputRecorder> recorder =
+      std::make_unique<InputRecorder>(path);
+  if (!recorder->valid()) {
+    return false;
+  }
+  _recorder     = std::move(recorder);
+  _record_begin = _frame;
+  _record_state();
+  return true;
+}
+
+void Input::stop_recording() {
+  if (_recorder != nullptr) {
+    uint32_t frames = _frame - _record_begin;
+    _recorder->finish(frames > 0 ? frames - 1 : 0);
+    _recorder.reset();
+  }
+}
+
+bool Input::start_replay(const std::string_view& path) {
+  CONTEXT_CONDITION_ERROR_RETURN("INPUT", _recorder == nullptr, false,
+                                 "Cannot replay while recording");
+  std::unique_ptr<InputReplay> replay = std::make_unique<InputReplay>(path);
+  if (!replay->valid()) {
+    return false;
+  }
+
+  // Start from a clean state so the replay does not depend on what was held
+  // before it
+  _keys_down.reset();
+  _mouse_down.reset();
+  _gamepads.reset();
+  _text.clear();
+  _scroll         = glm::vec2(0.0f);
+  _scroll_pending = glm::vec2(0.0f);
+  _mods           = 0;
+  _replay       = std::move(replay);
+  _replay_begin = _frame;
+  return true;
+}
+
+void Input::stop_replay() {
+  _replay.reset();
+}
+
+bool Input::replay_finished() const {
+  return _replay != nullptr && _replay->finished(_frame - _replay_begin);
+}
+
+void Input::_emit(InputRecordType type, int code, int action, int mods) {
+  _emit(InputRecordEvent::make(input_time_ns(), _frame, type, code, action,
+                               mods));
+}
+
+void Input::_emit(const InputRecordEvent& event) {
+  if (_latency_pending_count < s_LatencyPending) {
+    _latency_pending[_latency_pending_count++] = {event.time_ns, _frame};
+  }
+  if (_recorder != nullptr) {
+    InputRecordEvent recorded = event;
+    recorded.frame -= _record_begin;
+    _recorder->record(recorded);
+  }
+  if (_event_queue != nullptr) {
+    _event_queue->push(event);
+  }
+}
+
+void Input::_resolve_latency() {
+  // Pending events are in dispatch order. Events dispatched during an
+  // earlier poll_events were consumed by the frame just presented, the ones
+  // pumped since (e.g. while the pacer waited for that present) only reach
+  // the screen with the next one, even though they came before the swap
+  uint64_t present = _window_ptr->last_swap_ns();
+  _latency.advance(present);
+  size_t presented = 0;
+  while (presented < _latency_pending_count &&
+         _latency_pending[presented].frame < _frame) {
+    const LatencyPending& pending = _latency_pending[presented];
+    _latency.record(present - std::min(pending.time_ns, present), present);
+    presented++;
+  }
+  if (presented > 0) {
+    std::copy(_latency_pending + presented,
+              _latency_pending + _latency_pending_count, _latency_pending);
+    _latency_pending_count -= presented;
+  }
+}
+
+void Input::_emit_gamepad_buttons() {
+  for (size_t joystick = 0; joystick < InputGamepads::s_Joysticks;
+       joystick++) {
+    uint16_t pressed  = _gamepads.pressed_mask(joystick);
+    uint16_t released = _gamepads.released_mask(joystick);
+    for (int button = 0; (pressed | released) >> button; button++) {
+      uint16_t bit = (uint16_t)(1u << button);
+      if ((pressed | released) & bit) {
+        _emit(InputRecordType_GamepadButton, (int)(joystick << 8) | button,
+              (pressed & bit) ? GLFW_PRESS : GLFW_RELEASE, 0);
+      }
     }
-    reg_counted++;
+  }
+}
 
-    if (!reg.rm_nx_frame) {
-      reg.rm_nx_frame = true;
-    } else {
-      reg.type = InputType::Unknown;
-      s_instance->_reg_active_count--;
+void Input::_emit_gamepad_axes() {
+  for (size_t joystick = 0; joystick < InputGamepads::s_Joysticks;
+       joystick++) {
+    uint8_t changed = _gamepads.axis_changed_mask(joystick);
+    for (int axis = 0; changed >> axis; axis++) {
+      if (changed & (1u << axis)) {
+        _emit(InputRecordEvent::make_value(
+            input_time_ns(), _frame, InputRecordType_GamepadAxis,
+            (int)(joystick << 8) | axis, _gamepads.raw_axis(joystick, axis),
+            0.0f));
+      }
     }
   }
 }
 
-bool Input::_register_once(InputType type, int code, bool pressed) {
-  int free_index = -1;
-  for (size_t i = 0; i < _reg_buffer.size(); i++) {
-    if (_reg_buffer[i].type == InputType::Unknown) {
-      free_index = i;
+void Input::_record_state() {
+  // Analog state is only recorded when it changes, so the replay needs to
+  // know where it started. Only goes to the recorder, it is not an event
+  uint64_t now = input_time_ns();
+  _recorder->record(InputRecordEvent::make_value(
+      now, 0, InputRecordType_CursorPos, 0, _cursor.x, _cursor.y));
+  for (size_t joystick = 0; joystick < InputGamepads::s_Joysticks;
+       joystick++) {
+    if (!_gamepads.connected((GamepadJoystick)joystick)) {
       continue;
     }
-    bool found = _reg_buffer[i].type == type && _reg_buffer[i].code == code &&
-                 _reg_buffer[i].pressed == pressed;
-    if (found) {
-      _reg_buffer[i].rm_nx_frame = false;
-      return false;
+    for (size_t axis = 0; axis < InputGamepads::s_Axes; axis++) {
+      _recorder->record(InputRecordEvent::make_value(
+          now, 0, InputRecordType_GamepadAxis, (int)(joystick << 8 | axis),
+          _gamepads.raw_axis(joystick, axis), 0.0f));
     }
   }
+}
 
-  CONTEXT_CONDITION_ERROR_RETURN(
-      "INPUT", free_index != -1, false,
-      "Toggle register buffer full, cannot add {} {}", type_to_string(type),
-      code);
+void Input::_replay_frame() {
+  size_t count                  = 0;
+  const InputRecordEvent* event =
+      _replay->next_frame(_frame - _replay_begin, &count);
+  for (size_t i = 0; i < count; i++, event++) {
+    switch (event->type) {
+    case InputRecordType_Key:
+      _dispatch_key(event->code, 0, event->action(), event->mods());
+      break;
+    case InputRecordType_MouseButton:
+      _dispatch_mouse_button(event->code, event->action(), event->mods());
+      break;
+    case InputRecordType_Char:
+      _dispatch_char(event->codepoint());
+      break;
+    case InputRecordType_GamepadButton:
+      _gamepads.set_button(event->code >> 8, event->code & 0xff,
+                           event->action() == GLFW_PRESS);
+      _emit(InputRecordType_GamepadButton, event->code, event->action(), 0);
+      break;
+    case InputRecordType_GamepadAxis:
+      _gamepads.set_axis(event->code >> 8, event->code & 0xff, event->x);
+      _emit(InputRecordEvent::make_value(input_time_ns(), _frame,
+                                         InputRecordType_GamepadAxis,
+                                         event->code, event->x, 0.0f));
+      break;
+    case InputRecordType_CursorPos:
+      _dispatch_cursor_pos(event->x, event->y);
+      break;
+    case InputRecordType_Scroll:
+      _dispatch_scroll(event->x, event->y);
+      break;
+    default:
+      CONTEXT_WARN_ONCE("INPUT", "Unknown input record type {}", event->type);
+      break;
+    }
+  }
+}
 
-  _reg_buffer[free_index] = RegisteredInput {
-      .type        = type,
-      .code        = code,
-      .rm_nx_frame = false,
-      .pressed     = pressed,
-  };
-  _reg_active_count++;
-  return true;
+void Input::_key_callback(GLFWwindow*, int key, int scancode, int action,
+                          int mods) {
+  if (s_instance != nullptr && s_instance->_replay == nullptr) {
+    s_instance->_dispatch_key(key, scancode, action, mods);
+  }
+}
+
+void Input::_mouse_button_callback(GLFWwindow*, int button, int action,
+                                   int mods) {
+  if (s_instance != nullptr && s_instance->_replay == nullptr) {
+    s_instance->_dispatch_mouse_button(button, action, mods);
+  }
+}
+
+void Input::_char_callback(GLFWwindow*, unsigned int codepoint) {
+  if (s_instance != nullptr && s_instance->_replay == nullptr) {
+    s_instance->_dispatch_char((char32_t)codepoint);
+  }
+}
+
+void Input::_cursor_pos_callback(GLFWwindow*, double x, double y) {
+  if (s_instance != nullptr && s_instance->_replay == nullptr) {
+    s_instance->_dispatch_cursor_pos((float)x, (float)y);
+  }
+}
+
+void Input::_scroll_callback(GLFWwindow*, double x, double y) {
+  if (s_instance != nullptr && s_instance->_replay == nullptr) {
+    s_instance->_dispatch_scroll((float)x, (float)y);
+  }
+}
+
+void Input::_dispatch_key(int key, int scancode, int action, int mods) {
+  _emit(InputRecordType_Key, key, action, mods);
+  _key_event(key, action, mods);
+  if (_prev_key_callback != nullptr) {
+    _prev_key_callback(_window_ptr->handle_ptr(), key, scancode, action,
+                       mods);
+  }
+}
+
+void Input::_dispatch_mouse_button(int button, int action, int mods) {
+  _emit(InputRecordType_MouseButton, button, action, mods);
+  _mouse_button_event(button, action, mods);
+  if (_prev_mouse_button_callback != nullptr) {
+    _prev_mouse_button_callback(_window_ptr->handle_ptr(), button, action,
+                                mods);
+  }
+}
+
+void Input::_key_event(int key, int action, int mods) {
+  _mods = mods;
+  if (key < 0 || key > KeyCode_Last || action == GLFW_REPEAT) {
+    return;
+  }
+  bool down = action == GLFW_PRESS;
+  if (down != _keys_down[key]) {
+    _keys_down[key] = down;
+    (down ? _keys_pressed_pending : _keys_released_pending)[key] = true;
+  }
+}
+
+void Input::_mouse_button_event(int button, int action, int mods) {
+  _mods = mods;
+  if (button < 0 || button > MouseButton_Last) {
+    return;
+  }
+  bool down = action == GLFW_PRESS;
+  if (down != _mouse_down[button]) {
+    _mouse_down[button] = down;
+    (down ? _mouse_pressed_pending : _mouse_released_pending)[button] = true;
+  }
+}
+
+void Input::_dispatch_char(char32_t codepoint) {
+  _emit(InputRecordEvent::make_char(input_time_ns(), _frame, codepoint));
+  _text.push(codepoint, _frame);
+  if (_prev_char_callback != nullptr) {
+    _prev_char_callback(_window_ptr->handle_ptr(), (unsigned int)codepoint);
+  }
+}
+
+void Input::_dispatch_cursor_pos(float x, float y) {
+  _emit(InputRecordEvent::make_value(input_time_ns(), _frame,
+                                     InputRecordType_CursorPos, 0, x, y));
+  _cursor = glm::vec2(x, y);
+  if (_prev_cursor_pos_callback != nullptr) {
+    _prev_cursor_pos_callback(_window_ptr->handle_ptr(), (double)x,
+                              (double)y);
+  }
+}
+
+void Input::_dispatch_scroll(float x, float y) {
+  _emit(InputRecordEvent::make_value(input_time_ns(), _frame,
+                                     InputRecordType_Scroll, 0, x, y));
+  _scroll_pending += glm::vec2(x, y);
+  if (_prev_scroll_callback != nullptr) {
+    _prev_scroll_callback(_window_ptr->handle_ptr(), (double)x, (double)y);
+  }
 }
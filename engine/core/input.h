@@ -15,19 +15,18 @@
 #ifndef CORE_INPUT_H
 #define CORE_INPUT_H
 
+#include "core/input_actions.h"
+#include "core/input_events.h"
+#include "core/input_gamepad.h"
+#include "core/input_latency.h"
 #include "core/input_key_codes.h"
+#include "core/input_recording.h"
+#include "core/input_text.h"
 #include "gfx_rhi/window_handle.h"
-#include <array>
 #include <fmt/format.h>
+#include <memory>
 #include <string_view>
 
-enum InputType {
-  Unknown = -1,
-  Keyboard,
-  Mouse,
-  GamePad,
-};
-
 enum MouseMode {
   Invalid = -1,
   Visable,
@@ -35,17 +34,37 @@ enum MouseMode {
   Captured,
 };
 
-struct RegisteredInput {
-  InputType type   = InputType::Unknown;
-  int code         = -1;
-  bool rm_nx_frame = false; /// Remove next frame?
-  bool pressed     = false;
-};
+using InputKeyCallback         = void (*)(GLFWwindow*, int, int, int, int);
+using InputMouseButtonCallback = void (*)(GLFWwindow*, int, int, int);
+using InputCharCallback        = void (*)(GLFWwindow*, unsigned int);
+using InputCursorPosCallback   = void (*)(GLFWwindow*, double, double);
+using InputScrollCallback      = void (*)(GLFWwindow*, double, double);
 
+// Keyboard and mouse state is kept in bitsets indexed by KeyCode and
+// MouseButton, filled by GLFW callbacks during poll_events. Queries never
+// call into GLFW.
+//
+// - key_press/key_release: Current state
+// - key_pressed/key_released: The state changed since the previous
+//   poll_events, including in pump_events calls in between, so a press and
+//   release within one frame still counts. Actions see such a tap as held
+//   for that one frame
+//
+// Device events can be recorded into a stream and replayed in place of the
+// device events GLFW reports, see core/input_recording.h. Input chains to the
+// callbacks installed before it, so anything that has to see the replayed
+// events instead of the live ones (e.g. the ImGui GLFW backend) has to
+// install its callbacks before Input is constructed.
+//
+// With the event queue enabled every event is also stamped with
+// input_time_ns() and published to an InputEventQueue, so a fixed step
+// simulation can apply input at the step it happened in instead of at the
+// frame boundary. GLFW only delivers events on the main thread, pump_events
+// can be called more often than once per frame to tighten the timestamps,
+// see FramePacer::set_wait_callback.
 struct Input {
-  static constexpr size_t RegisterOnceBufferSize = 16;
-
   Input(WindowHandle* manager_ptr);
+  ~Input();
 
   static bool key_pressed(KeyCode code);
   static bool key_released(KeyCode code);
@@ -59,18 +78,148 @@ struct Input {
   static bool mouse_press(MouseButton button);
   static bool mouse_release(MouseButton button);
 
+  // Cursor position in screen coordinates relative to the window
+  static glm::vec2 mouse_position();
+  // Scroll offset since the previous poll_events
+  static glm::vec2 mouse_scroll();
+
+  // KeyMod bits of the last key event
+  static int key_mods();
+
+  // Gamepads are polled and filtered once per poll_events, see
+  // core/input_gamepad.h
+  static const InputGamepads& gamepads();
+  static InputGamepadConfig& gamepad_config();
+  static bool gamepad_connected(GamepadJoystick joystick);
+  static float gamepad_axis(GamepadJoystick joystick, GamepadAxis axis);
+  static bool gamepad_pressed(GamepadJoystick joystick, GamepadButton button);
+  static bool gamepad_released(GamepadJoystick joystick, GamepadButton button);
+  static bool gamepad_press(GamepadJoystick joystick, GamepadButton button);
+
+  // Actions are resolved once per poll_events, see core/input_actions.h
+  static InputActionMap& action_map();
+  static bool action_pressed(InputAction action);
+  static bool action_released(InputAction action);
+  static bool action_press(InputAction action);
+
+  // Number of poll_events calls so far
+  static uint32_t frame();
+
+  // Characters typed, drained by the focused text field, see
+  // core/input_text.h
+  static InputTextBuffer& text();
+
+  // Time from an event being dispatched to the next swap_buffers call, i.e.
+  // the present of the frame that consumed it
+  static const InputLatency& latency();
+
+  // Null unless enabled with set_event_queue. Popped by a single consumer,
+  // which may run on another thread
+  static InputEventQueue* event_queue();
+
   static std::string_view type_to_string(InputType type);
   static std::string_view mouse_mode_to_string(MouseMode mode);
 
+  // Starts a new frame: clears the pressed and released state, pumps the
+  // events and resolves gamepads and actions
   void poll_events();
+  // Dispatches pending GLFW events without starting a new frame, main thread
+  // only like glfwPollEvents. Their pressed and released state shows up in
+  // the next poll_events
+  void pump_events();
+
+  // Has to be set before a consumer starts popping
+  void set_event_queue(bool enabled);
+
+  // Records every device event from the next poll_events on, frames are
+  // counted from the start of the recording. The current gamepad axes and
+  // cursor position are recorded first
+  bool start_recording(const std::string_view& path);
+  void stop_recording();
+  inline bool recording() const { return _recorder != nullptr; }
+
+  // Replays a recording from the next poll_events on. Device events from
+  // GLFW are dropped and gamepads are not polled while replaying
+  bool start_replay(const std::string_view& path);
+  void stop_replay();
+  inline bool replaying() const { return _replay != nullptr; }
+  // Every recorded frame has been replayed
+  bool replay_finished() const;
 
 private:
-  bool _register_once(InputType type, int code, bool pressed);
+  static void _key_callback(GLFWwindow* window, int key, int scancode,
+                            int action, int mods);
+  static void _mouse_button_callback(GLFWwindow* window, int button,
+                                     int action, int mods);
+  static void _char_callback(GLFWwindow* window, unsigned int codepoint);
+  static void _cursor_pos_callback(GLFWwindow* window, double x, double y);
+  static void _scroll_callback(GLFWwindow* window, double x, double y);
+
+  void _dispatch_key(int key, int scancode, int action, int mods);
+  void _dispatch_mouse_button(int button, int action, int mods);
+  void _dispatch_char(char32_t codepoint);
+  void _dispatch_cursor_pos(float x, float y);
+  void _dispatch_scroll(float x, float y);
+  void _key_event(int key, int action, int mods);
+  void _mouse_button_event(int button, int action, int mods);
+
+private:
+  void _emit(InputRecordType type, int code, int action, int mods);
+  void _emit(const InputRecordEvent& event);
+  void _emit_gamepad_buttons();
+  void _emit_gamepad_axes();
+  void _record_state();
+  void _resolve_latency();
+  void _replay_frame();
 
 private:
   WindowHandle* _window_ptr = nullptr;
-  size_t _reg_active_count  = 0;
-  std::array<RegisteredInput, RegisterOnceBufferSize> _reg_buffer;
+
+  InputKeyBits _keys_down;
+  InputKeyBits _keys_pressed;
+  InputKeyBits _keys_released;
+  InputMouseBits _mouse_down;
+  InputMouseBits _mouse_pressed;
+  InputMouseBits _mouse_released;
+  // Edges since the last poll_events, published by the next one
+  InputKeyBits _keys_pressed_pending;
+  InputKeyBits _keys_released_pending;
+  InputMouseBits _mouse_pressed_pending;
+  InputMouseBits _mouse_released_pending;
+  // Floats as recorded, so replays reproduce them exactly
+  glm::vec2 _cursor         = glm::vec2(0.0f);
+  glm::vec2 _scroll         = glm::vec2(0.0f);
+  glm::vec2 _scroll_pending = glm::vec2(0.0f);
+  int _mods                 = 0;
+  uint32_t _frame           = 0;
+
+  InputGamepads _gamepads;
+  InputTextBuffer _text;
+  InputActionMap _actions;
+
+  // Events waiting for the present of the frame that consumes them, events
+  // past the capacity are not measured
+  struct LatencyPending {
+    uint64_t time_ns = 0;  // Dispatch time
+    uint32_t frame   = 0;  // Input::frame() when dispatched
+  };
+  static constexpr size_t s_LatencyPending = 64;
+  InputLatency _latency;
+  LatencyPending _latency_pending[s_LatencyPending];
+  size_t _latency_pending_count = 0;
+
+  std::unique_ptr<InputEventQueue> _event_queue;
+  std::unique_ptr<InputRecorder> _recorder;
+  uint32_t _record_begin = 0;
+  std::unique_ptr<InputReplay> _replay;
+  uint32_t _replay_begin = 0;
+
+  // Callbacks installed before ours, still called for every event
+  InputKeyCallback _prev_key_callback                  = nullptr;
+  InputMouseButtonCallback _prev_mouse_button_callback = nullptr;
+  InputCharCallback _prev_char_callback                = nullptr;
+  InputCursorPosCallback _prev_cursor_pos_callback     = nullptr;
+  InputScrollCallback _prev_scroll_callback            = nullptr;
 };
 
 #endif
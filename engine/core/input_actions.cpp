@@ -0,0 +1,259 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/input_actions.h"
+#include "core/console.h"
+#include <algorithm>
+
+InputBinding InputBinding::key(KeyCode code, int mods) {
+  InputBinding binding;
+  binding.mods = mods;
+  return binding.with(code);
+}
+
+InputBinding InputBinding::mouse(MouseButton button, int mods) {
+  InputBinding binding;
+  binding.mods = mods;
+  return binding.with(button);
+}
+
+InputBinding InputBinding::gamepad(GamepadButton button) {
+  InputBinding binding;
+  return binding.with(button);
+}
+
+#define INPUT_BINDING_WITH_IMPL(_type, _code)                                  \
+  CONTEXT_CONDITION_ERROR_RETURN("INPUT", count < s_MaxInputs, *this,          \
+                                 "Binding already has {} inputs", count);      \
+  inputs[count++] = Source {.type = (_type), .code = (int)(_code)};            \
+  return *this
+
+InputBinding& InputBinding::with(KeyCode code) {
+  INPUT_BINDING_WITH_IMPL(InputType::Keyboard, code);
+}
+
+InputBinding& InputBinding::with(MouseButton button) {
+  INPUT_BINDING_WITH_IMPL(InputType::Mouse, button);
+}
+
+InputBinding& InputBinding::with(GamepadButton button) {
+  INPUT_BINDING_WITH_IMPL(InputType::GamePad, button);
+}
+
+InputAction InputActionMap::add_action(std::string_view name) {
+  InputAction action = find_action(name);
+  if (action != s_InvalidAction) {
+    return action;
+  }
+  action = (InputAction)_names.size();
+  _names.emplace_back(name);
+  _handles.emplace(_names.back(), action);
+  _bindings.emplace_back();
+  _state.push_back(0);
+  return action;
+}
+
+InputAction InputActionMap::find_action(std::string_view name) const {
+  auto handle = _handles.find(std::string(name));
+  return handle != _handles.end() ? handle->second : s_InvalidAction;
+}
+
+std::string_view InputActionMap::action_name(InputAction action) const {
+  return action < _names.size() ? std::string_view(_names[action])
+                                : std::string_view("Invalid");
+}
+
+bool InputActionMap::bind(InputAction action, const InputBinding& binding) {
+  CONTEXT_CONDITION_ERROR_RETURN("INPUT", action < _names.size(), false,
+                                 "Invalid action handle {}", action);
+  _bindings[action].push_back(binding);
+  _compile(action);
+  return true;
+}
+
+bool InputActionMap::set_bindings(InputAction action,
+                                  const std::vector<InputBinding>& bindings) {
+  CONTEXT_CONDITION_ERROR_RETURN("INPUT", action < _names.size(), false,
+                                 "Invalid action handle {}", action);
+  _bindings[action] = bindings;
+  _compile(action);
+  return true;
+}
+
+bool InputActionMap::clear_bindings(InputAction action) {
+  return set_bindings(action, {});
+}
+
+void InputActionMap::update(const InputKeyBits& keys,
+                            const InputMouseBits& mouse,
+                            const InputGamepadButtonBits& gamepad,
+                            int lock_mods) {
+  auto set_bit = [this](size_t bit) {
+    _input_state[bit / 64] |= uint64_t(1) << (bit % 64);
+  };
+
+  _input_state.fill(0);
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (keys[i]) {
+      set_bit(s_KeyBase + i);
+    }
+  }
+  for (size_t i = 0; i < mouse.size(); i++) {
+    if (mouse[i]) {
+      set_bit(s_MouseBase + i);
+    }
+  }
+  for (size_t i = 0; i < gamepad.size(); i++) {
+    if (gamepad[i]) {
+      set_bit(s_GamepadBase + i);
+    }
+  }
+
+  // Modifiers are held when either side is, the lock modifiers only exist
+  // as event state
+  int mods = lock_mods & (KeyMod_CapsLock | KeyMod_NumLock);
+  if (keys[KeyCode_LeftShift] || keys[KeyCode_RightShift]) {
+    mods |= KeyMod_Shift;
+  }
+  if (keys[KeyCode_LeftControl] || keys[KeyCode_RightControl]) {
+    mods |= KeyMod_Control;
+  }
+  if (keys[KeyCode_LeftAlt] || keys[KeyCode_RightAlt]) {
+    mods |= KeyMod_Alt;
+  }
+  if (keys[KeyCode_LeftSuper] || keys[KeyCode_RightSuper]) {
+    mods |= KeyMod_Super;
+  }
+  for (size_t i = 0; i < s_ModCount; i++) {
+    if (mods & (1 << i)) {
+      set_bit(s_ModBase + i);
+    }
+  }
+
+  // Previous down state moves into the pressed/released bits below
+  for (uint8_t& state : _state) {
+    state = (state & State_DownBit) ? State_ReleasedBit : 0;
+  }
+  for (const CompiledBinding& binding : _compiled) {
+    const Term* term = _terms.data() + binding.term_begin;
+    const Term* end  = term + binding.term_count;
+    while (term != end &&
+           (_input_state[term->word] & term->mask) == term->mask) {
+      term++;
+    }
+    if (term == end) {
+      _state[binding.action] |= State_DownBit;
+    }
+  }
+  for (uint8_t& state : _state) {
+    if (state == (State_DownBit | State_ReleasedBit)) {
+      state = State_DownBit;
+    } else if (state == State_DownBit) {
+      state = State_DownBit | State_PressedBit;
+    }
+  }
+}
+
+void InputActionMap::_compile(InputAction action) {
+  std::vector<Term> terms;
+  std::vector<CompiledBinding> compiled;
+  for (const InputBinding& binding : _bindings[action]) {
+    std::array<uint64_t, s_StateWords> masks = {};
+    bool valid = binding.count > 0 || binding.mods != 0;
+    for (uint32_t i = 0; i < binding.count && valid; i++) {
+      size_t bit = _source_bit(binding.inputs[i]);
+      valid      = bit < s_StateBits;
+      if (valid) {
+        masks[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+    }
+    for (size_t i = 0; i < s_ModCount; i++) {
+      if (binding.mods & (1 << i)) {
+        size_t bit = s_ModBase + i;
+        masks[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+    }
+    if (!valid) {
+      CONTEXT_WARN("INPUT", "Ignoring invalid binding of {}", _names[action]);
+      continue;
+    }
+
+    CompiledBinding entry {.action = action, .term_begin = 0};
+    for (uint32_t word = 0; word < s_StateWords; word++) {
+      if (masks[word] != 0) {
+        terms.push_back(Term {.mask = masks[word], .word = word});
+        entry.term_count++;
+      }
+    }
+    compiled.push_back(entry);
+  }
+
+  // Splice the action's block into the flat tables, blocks after it only
+  // shift their term offsets
+  auto first = std::lower_bound(
+      _compiled.begin(), _compiled.end(), action,
+      [](const CompiledBinding& binding, InputAction action) {
+        return binding.action < action;
+      });
+  auto last = std::find_if(first, _compiled.end(),
+                           [action](const CompiledBinding& binding) {
+                             return binding.action != action;
+                           });
+  const uint32_t block_begin = first != _compiled.end()
+                                   ? first->term_begin
+                                   : (uint32_t)_terms.size();
+  uint32_t old_terms = 0;
+  for (auto it = first; it != last; it++) {
+    old_terms += it->term_count;
+  }
+
+  uint32_t term_begin = block_begin;
+  for (CompiledBinding& entry : compiled) {
+    entry.term_begin = term_begin;
+    term_begin += entry.term_count;
+  }
+  int64_t shift = (int64_t)terms.size() - (int64_t)old_terms;
+  for (auto it = last; it != _compiled.end(); it++) {
+    it->term_begin = (uint32_t)((int64_t)it->term_begin + shift);
+  }
+
+  _terms.erase(_terms.begin() + block_begin,
+               _terms.begin() + block_begin + old_terms);
+  _terms.insert(_terms.begin() + block_begin, terms.begin(), terms.end());
+  auto at = _compiled.erase(first, last);
+  _compiled.insert(at, compiled.begin(), compiled.end());
+}
+
+size_t InputActionMap::_source_bit(const InputBinding::Source& source) {
+  switch (source.type) {
+  case InputType::Keyboard:
+    if (source.code >= 0 && source.code <= KeyCode_Last) {
+      return s_KeyBase + source.code;
+    }
+    break;
+  case InputType::Mouse:
+    if (source.code >= 0 && source.code <= MouseButton_Last) {
+      return s_MouseBase + source.code;
+    }
+    break;
+  case InputType::GamePad:
+    if (source.code >= 0 && source.code <= GamepadButton_Last) {
+      return s_GamepadBase + source.code;
+    }
+    break;
+  default:
+    break;
+  }
+  return s_StateBits;
+}
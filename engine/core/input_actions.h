@@ -0,0 +1,151 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INPUT_ACTIONS_H
+#define CORE_INPUT_ACTIONS_H
+
+#include "core/input_key_codes.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum InputType {
+  Unknown = -1,
+  Keyboard,
+  Mouse,
+  GamePad,
+};
+
+using InputKeyBits           = std::bitset<KeyCode_Last + 1>;
+using InputMouseBits         = std::bitset<MouseButton_Last + 1>;
+using InputGamepadButtonBits = std::bitset<GamepadButton_Last + 1>;
+
+// Handle of an action, an index into the dense state array
+using InputAction = uint32_t;
+
+// All inputs of a binding and its KeyMod bits have to be held for the action
+// to be down, e.g. InputBinding::key(KeyCode_S, KeyMod_Control) or
+// InputBinding::mouse(MouseButton_Left).with(KeyCode_LeftAlt)
+struct InputBinding {
+  static constexpr size_t s_MaxInputs = 4;
+
+  struct Source {
+    InputType type = InputType::Unknown;
+    int code       = -1;
+  };
+
+  std::array<Source, s_MaxInputs> inputs;
+  uint32_t count = 0;
+  int mods       = 0;
+
+  static InputBinding key(KeyCode code, int mods = 0);
+  static InputBinding mouse(MouseButton button, int mods = 0);
+  static InputBinding gamepad(GamepadButton button);
+
+  InputBinding& with(KeyCode code);
+  InputBinding& with(MouseButton button);
+  InputBinding& with(GamepadButton button);
+};
+
+// Named actions bound to keyboard, mouse and gamepad inputs.
+//
+// Every binding is compiled into masks over a single bit vector holding the
+// key, mouse button, gamepad button and modifier state, so update() is a
+// handful of AND/compare operations per binding. The result is a dense state
+// array queried by InputAction. Changing the bindings of an action only
+// recompiles that action.
+class InputActionMap {
+public:
+  static constexpr InputAction s_InvalidAction = UINT32_MAX;
+
+public:
+  // Returns the existing handle when the name is already registered
+  InputAction add_action(std::string_view name);
+  InputAction find_action(std::string_view name) const;
+  std::string_view action_name(InputAction action) const;
+  inline size_t action_count() const { return _names.size(); }
+
+  // Return false for an invalid handle
+  bool bind(InputAction action, const InputBinding& binding);
+  bool set_bindings(InputAction action,
+                    const std::vector<InputBinding>& bindings);
+  bool clear_bindings(InputAction action);
+  inline const std::vector<InputBinding>& bindings(InputAction action) const {
+    return _bindings[action];
+  }
+
+  // - lock_mods: KeyMod_CapsLock and KeyMod_NumLock, the other modifiers
+  //   come from the key state
+  void update(const InputKeyBits& keys, const InputMouseBits& mouse,
+              const InputGamepadButtonBits& gamepad, int lock_mods);
+
+  inline bool down(InputAction action) const {
+    return _state[action] & State_DownBit;
+  }
+  inline bool pressed(InputAction action) const {
+    return _state[action] & State_PressedBit;
+  }
+  inline bool released(InputAction action) const {
+    return _state[action] & State_ReleasedBit;
+  }
+
+private:
+  // Bit layout of the input state
+  static constexpr size_t s_KeyBase     = 0;
+  static constexpr size_t s_MouseBase   = s_KeyBase + KeyCode_Last + 1;
+  static constexpr size_t s_GamepadBase = s_MouseBase + MouseButton_Last + 1;
+  static constexpr size_t s_ModBase  = s_GamepadBase + GamepadButton_Last + 1;
+  static constexpr size_t s_ModCount = 6;  // KeyMod bits in order
+  static constexpr size_t s_StateBits  = s_ModBase + s_ModCount;
+  static constexpr size_t s_StateWords = (s_StateBits + 63) / 64;
+
+  enum State : uint8_t {
+    State_DownBit     = 1 << 0,
+    State_PressedBit  = 1 << 1,
+    State_ReleasedBit = 1 << 2,
+  };
+
+  // One word of a compiled binding, the binding holds when every term does
+  struct Term {
+    uint64_t mask = 0;
+    uint32_t word = 0;
+  };
+  struct CompiledBinding {
+    uint32_t action     = 0;
+    uint32_t term_begin = 0;
+    uint32_t term_count = 0;
+  };
+
+  void _compile(InputAction action);
+  static size_t _source_bit(const InputBinding::Source& source);
+
+private:
+  std::vector<std::string> _names;
+  std::unordered_map<std::string, InputAction> _handles;
+  std::vector<std::vector<InputBinding>> _bindings;
+
+  // Flat tables, the compiled bindings of an action are contiguous and
+  // ordered by action
+  std::vector<Term> _terms;
+  std::vector<CompiledBinding> _compiled;
+
+  std::vector<uint8_t> _state;
+  std::array<uint64_t, s_StateWords> _input_state = {};
+};
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CORE_INPUT_EVENTS_H
+#define CORE_INPUT_EVENTS_H
+
+#include "core/input_recording.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Monotonic clock the input events are stamped with
+inline uint64_t input_time_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Single producer, single consumer ring of timestamped input events. The
+// producer is the thread pumping GLFW events, the consumer is usually a
+// fixed step simulation that takes the events up to the end of each step.
+//
+// Events use the recording layout with time_ns holding input_time_ns() at
+// dispatch. A full queue drops the new event and counts it.
+class InputEventQueue {
+public:
+  static constexpr size_t s_Capacity = 4096;
+  static_assert((s_Capacity & (s_Capacity - 1)) == 0,
+                "Capacity has to be a power of two");
+
+public:
+  // Producer only
+  inline bool push(const InputRecordEvent& event) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) == s_Capacity) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    _events[tail & (s_Capacity - 1)] = event;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only, takes the oldest event if it happened at or before
+  // until_ns
+  inline bool pop(InputRecordEvent& out, uint64_t until_ns = UINT64_MAX) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    const InputRecordEvent& event = _events[head & (s_Capacity - 1)];
+    if (event.time_ns > until_ns) {
+      return false;
+    }
+    out = event;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  inline uint64_t dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  alignas(64) std::atomic<size_t> _head      = 0;
+  alignas(64) std::atomic<size_t> _tail      = 0;
+  alignas(64) std::atomic<uint64_t> _dropped = 0;
+  InputRecordEvent _events[s_Capacity];
+};
+
+#endif
@@ -0,0 +1,175 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input_gamepad.h"
+#include <algorithm>
+#include <cmath>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+static_assert(GamepadJoystick_LAST == GLFW_JOYSTICK_LAST &&
+                  GamepadButton_Last == GLFW_GAMEPAD_BUTTON_LAST &&
+                  GamepadAxis_Last == GLFW_GAMEPAD_AXIS_LAST,
+              "Gamepad codes have to match GLFW");
+
+static constexpr bool _is_trigger(size_t axis) {
+  return axis == GamepadAxis_LeftTrigger || axis == GamepadAxis_RightTrigger;
+}
+
+InputGamepads::InputGamepads() {
+  reset();
+}
+
+void InputGamepads::reset() {
+  _connected = 0;
+  for (size_t axis = 0; axis < s_Axes; axis++) {
+    for (size_t joystick = 0; joystick < s_Joysticks; joystick++) {
+      // GLFW reports a released trigger as -1
+      _raw[axis][joystick]  = _is_trigger(axis) ? -1.0f : 0.0f;
+      _axes[axis][joystick] = 0.0f;
+    }
+  }
+  std::fill(std::begin(_down), std::end(_down), 0);
+  std::fill(std::begin(_pressed), std::end(_pressed), 0);
+  std::fill(std::begin(_released), std::end(_released), 0);
+  std::fill(std::begin(_axis_changed), std::end(_axis_changed), 0);
+}
+
+void InputGamepads::poll() {
+  begin_frame();
+
+  GLFWgamepadstate state;
+  for (size_t joystick = 0; joystick < s_Joysticks; joystick++) {
+    uint32_t bit = 1u << joystick;
+    if (!glfwGetGamepadState((int)joystick, &state)) {
+      if (_connected & bit) {
+        _connected &= ~bit;
+        _released[joystick] = _down[joystick];
+        _down[joystick]     = 0;
+        for (size_t axis = 0; axis < s_Axes; axis++) {
+          _raw[axis][joystick]  = _is_trigger(axis) ? -1.0f : 0.0f;
+          _axes[axis][joystick] = 0.0f;
+        }
+        _axis_changed[joystick] = (1u << s_Axes) - 1;
+      }
+      continue;
+    }
+
+    _connected |= bit;
+    uint16_t down = 0;
+    for (int button = 0; button <= GamepadButton_Last; button++) {
+      down |= (uint16_t)((state.buttons[button] == GLFW_PRESS) << button);
+    }
+    _pressed[joystick]  = down & ~_down[joystick];
+    _released[joystick] = _down[joystick] & ~down;
+    _down[joystick]     = down;
+    uint8_t changed = 0;
+    for (size_t axis = 0; axis < s_Axes; axis++) {
+      changed |= (uint8_t)((state.axes[axis] != _raw[axis][joystick]) << axis);
+      _raw[axis][joystick] = state.axes[axis];
+    }
+    _axis_changed[joystick] = changed;
+  }
+}
+
+void InputGamepads::set_button(int joystick, int button, bool down) {
+  if (joystick < 0 || joystick >= (int)s_Joysticks || button < 0 ||
+      button > GamepadButton_Last) {
+    return;
+  }
+  uint16_t bit = (uint16_t)(1u << button);
+  if (((_down[joystick] & bit) != 0) != down) {
+    _down[joystick] ^= bit;
+    (down ? _pressed : _released)[joystick] |= bit;
+  }
+}
+
+void InputGamepads::set_axis(int joystick, int axis, float value) {
+  if (joystick < 0 || joystick >= (int)s_Joysticks || axis < 0 ||
+      axis >= (int)s_Axes) {
+    return;
+  }
+  _axis_changed[joystick] |= (uint8_t)(1u << axis);
+  _raw[axis][joystick] = value;
+}
+
+void InputGamepads::begin_frame() {
+  std::fill(std::begin(_pressed), std::end(_pressed), 0);
+  std::fill(std::begin(_released), std::end(_released), 0);
+  std::fill(std::begin(_axis_changed), std::end(_axis_changed), 0);
+}
+
+void InputGamepads::process() {
+  _process_stick<GamepadAxis_LeftX, GamepadAxis_LeftY>();
+  _process_stick<GamepadAxis_RightX, GamepadAxis_RightY>();
+  _process_trigger<GamepadAxis_LeftTrigger>();
+  _process_trigger<GamepadAxis_RightTrigger>();
+}
+
+InputGamepadButtonBits InputGamepads::any_down() const {
+  uint16_t down = 0;
+  for (size_t joystick = 0; joystick < s_Joysticks; joystick++) {
+    down |= _down[joystick];
+  }
+  return InputGamepadButtonBits(down);
+}
+
+// The loops below run over every slot, connected or not, and are kept free
+// of branches so each one becomes a few SIMD iterations over the row. The
+// rows are template arguments so the compiler can tell they never overlap
+
+// Clamps to [0, 1] without the compare and select std::clamp turns into
+static inline float _saturate(float value) {
+  return 0.5f * (std::fabs(value) - std::fabs(value - 1.0f) + 1.0f);
+}
+
+template <GamepadAxis x_axis, GamepadAxis y_axis>
+void InputGamepads::_process_stick() {
+  const float dead_zone = std::clamp(_config.stick_dead_zone, 0.0f, 0.99f);
+  const float inv_range = 1.0f / (1.0f - dead_zone);
+  const float curve     = _config.response_curve;
+  const float keep      = std::clamp(_config.smoothing, 0.0f, 0.99f);
+
+  const float* raw_x = _raw[x_axis];
+  const float* raw_y = _raw[y_axis];
+  float* out_x       = _axes[x_axis];
+  float* out_y       = _axes[y_axis];
+  for (size_t i = 0; i < s_Joysticks; i++) {
+    float length = std::sqrt(raw_x[i] * raw_x[i] + raw_y[i] * raw_y[i]);
+    float scaled = _saturate((length - dead_zone) * inv_range);
+    float curved = scaled * (1.0f + curve * (scaled * scaled - 1.0f));
+    float scale  = curved / (length + 1e-6f);
+    out_x[i]     = raw_x[i] * scale + keep * (out_x[i] - raw_x[i] * scale);
+    out_y[i]     = raw_y[i] * scale + keep * (out_y[i] - raw_y[i] * scale);
+  }
+}
+
+template <GamepadAxis axis>
+void InputGamepads::_process_trigger() {
+  const float dead_zone = std::clamp(_config.trigger_dead_zone, 0.0f, 0.99f);
+  const float inv_range = 1.0f / (1.0f - dead_zone);
+  const float curve     = _config.response_curve;
+  const float keep      = std::clamp(_config.smoothing, 0.0f, 0.99f);
+
+  const float* raw = _raw[axis];
+  float* out       = _axes[axis];
+  for (size_t i = 0; i < s_Joysticks; i++) {
+    float value  = (raw[i] + 1.0f) * 0.5f;
+    float scaled = _saturate((value - dead_zone) * inv_range);
+    float curved = scaled * (1.0f + curve * (scaled * scaled - 1.0f));
+    out[i]       = curved + keep * (out[i] - curved);
+  }
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CORE_INPUT_GAMEPAD_H
+#define CORE_INPUT_GAMEPAD_H
+
+#include "core/input_actions.h"
+#include "core/input_key_codes.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct InputGamepadConfig {
+  // Radial dead zone of the sticks and the dead zone of the triggers, the
+  // range past it is rescaled to [0, 1]
+  float stick_dead_zone   = 0.15f;
+  float trigger_dead_zone = 0.05f;
+  // Blend between a linear (0) and a cubic (1) response
+  float response_curve = 0.0f;
+  // Weight of the previous frame's value, 0 disables the low pass filter
+  float smoothing = 0.0f;
+};
+
+// State of every joystick slot GLFW has, stored as structure of arrays so
+// each axis or button mask is one contiguous row indexed by GamepadJoystick.
+//
+// poll() reads all connected gamepads, process() then runs the dead zone,
+// response curve and filter as one branch free pass over whole rows, which
+// the compiler vectorizes. Queries only read the processed rows.
+class InputGamepads {
+public:
+  static constexpr size_t s_Joysticks = GamepadJoystick_LAST + 1;
+  static constexpr size_t s_Axes      = GamepadAxis_Last + 1;
+
+public:
+  InputGamepads();
+
+  inline InputGamepadConfig& config() { return _config; }
+  inline const InputGamepadConfig& config() const { return _config; }
+
+  // Reads the raw state of every connected gamepad and updates the button
+  // masks, a gamepad that disconnects reads as released and centered
+  void poll();
+  // Applies a button change without polling, used when replaying
+  void set_button(int joystick, int button, bool down);
+  // Applies a raw GLFW axis value without polling, used when replaying
+  void set_axis(int joystick, int axis, float value);
+  // Clears the pressed, released and axis changed masks, called before
+  // set_button and set_axis
+  void begin_frame();
+  void process();
+  // Releases and centers everything, keeps the config
+  void reset();
+
+  inline bool connected(GamepadJoystick joystick) const {
+    return _connected & (1u << joystick);
+  }
+  // Sticks in [-1, 1], triggers in [0, 1]
+  inline float axis(GamepadJoystick joystick, GamepadAxis axis) const {
+    return _axes[axis][joystick];
+  }
+  inline glm::vec2 left_stick(GamepadJoystick joystick) const {
+    return glm::vec2(_axes[GamepadAxis_LeftX][joystick],
+                     _axes[GamepadAxis_LeftY][joystick]);
+  }
+  inline glm::vec2 right_stick(GamepadJoystick joystick) const {
+    return glm::vec2(_axes[GamepadAxis_RightX][joystick],
+                     _axes[GamepadAxis_RightY][joystick]);
+  }
+
+  inline bool press(GamepadJoystick joystick, GamepadButton button) const {
+    return _down[joystick] & (1u << button);
+  }
+  inline bool pressed(GamepadJoystick joystick, GamepadButton button) const {
+    return _pressed[joystick] & (1u << button);
+  }
+  inline bool released(GamepadJoystick joystick, GamepadButton button) const {
+    return _released[joystick] & (1u << button);
+  }
+  inline uint16_t pressed_mask(size_t joystick) const {
+    return _pressed[joystick];
+  }
+  inline uint16_t released_mask(size_t joystick) const {
+    return _released[joystick];
+  }
+  // Axes whose raw value changed this frame, bit per GamepadAxis
+  inline uint8_t axis_changed_mask(size_t joystick) const {
+    return _axis_changed[joystick];
+  }
+  // Value as GLFW reported it, before process()
+  inline float raw_axis(size_t joystick, size_t axis) const {
+    return _raw[axis][joystick];
+  }
+
+  // Buttons held on any gamepad
+  InputGamepadButtonBits any_down() const;
+
+private:
+  template <GamepadAxis x_axis, GamepadAxis y_axis>
+  void _process_stick();
+  template <GamepadAxis axis>
+  void _process_trigger();
+
+private:
+  InputGamepadConfig _config;
+  uint32_t _connected = 0;  // Bit per joystick
+
+  alignas(64) float _raw[s_Axes][s_Joysticks];
+  alignas(64) float _axes[s_Axes][s_Joysticks];
+  alignas(32) uint16_t _down[s_Joysticks];
+  alignas(32) uint16_t _pressed[s_Joysticks];
+  alignas(32) uint16_t _released[s_Joysticks];
+  uint8_t _axis_changed[s_Joysticks];
+};
+
+#endif
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input_latency.h"
+#include "core/console.h"
+#include <algorithm>
+#include <cstring>
+
+InputLatency::InputLatency(uint32_t slice_ms)
+    : _slice_ns((uint64_t)slice_ms * 1000000) {
+  reset();
+}
+
+void InputLatency::advance(uint64_t now_ns) {
+  if (now_ns - _slice_begin_ns >= _slice_ns) {
+    // Skip as many slices as have passed, clearing each
+    uint64_t passed = (now_ns - _slice_begin_ns) / _slice_ns;
+    for (uint64_t i = 0; i < std::min<uint64_t>(passed, s_Slices); i++) {
+      _slice = (_slice + 1) % s_Slices;
+      std::memset(_counts[_slice], 0, sizeof(_counts[_slice]));
+      _max_ns[_slice] = 0;
+    }
+    _slice_begin_ns = _slice_begin_ns == 0
+                          ? now_ns
+                          : _slice_begin_ns + passed * _slice_ns;
+  }
+}
+
+void InputLatency::record(uint64_t latency_ns, uint64_t now_ns) {
+  advance(now_ns);
+  _counts[_slice][_bucket(latency_ns / 1000)]++;
+  _max_ns[_slice] = std::max(_max_ns[_slice], latency_ns);
+}
+
+void InputLatency::reset() {
+  std::memset(_counts, 0, sizeof(_counts));
+  std::memset(_max_ns, 0, sizeof(_max_ns));
+  _slice          = 0;
+  _slice_begin_ns = 0;
+}
+
+InputLatency::Summary InputLatency::summary() const {
+  uint64_t counts[s_Buckets] = {};
+  Summary summary;
+  uint64_t max_ns = 0;
+  for (size_t slice = 0; slice < s_Slices; slice++) {
+    for (size_t bucket = 0; bucket < s_Buckets; bucket++) {
+      counts[bucket] += _counts[slice][bucket];
+      summary.count += _counts[slice][bucket];
+    }
+    max_ns = std::max(max_ns, _max_ns[slice]);
+  }
+  if (summary.count == 0) {
+    return summary;
+  }
+
+  summary.max_ms = (double)max_ns / 1e6;
+  auto percentile = [&](double p) {
+    uint64_t target = (uint64_t)(p * (double)(summary.count - 1)) + 1;
+    uint64_t seen   = 0;
+    for (size_t bucket = 0; bucket < s_Buckets; bucket++) {
+      seen += counts[bucket];
+      if (seen >= target) {
+        return std::min(_bucket_upper_ms(bucket), summary.max_ms);
+      }
+    }
+    return summary.max_ms;
+  };
+  summary.p50_ms = percentile(0.50);
+  summary.p95_ms = percentile(0.95);
+  summary.p99_ms = percentile(0.99);
+  return summary;
+}
+
+void InputLatency::log() const {
+  Summary result = summary();
+  CONTEXT_INFO("INPUT",
+               "Input to present latency over {} events: p50 {:.2f}ms, p95 "
+               "{:.2f}ms, p99 {:.2f}ms, max {:.2f}ms",
+               result.count, result.p50_ms, result.p95_ms, result.p99_ms,
+               result.max_ms);
+}
+
+size_t InputLatency::_bucket(uint64_t us) {
+  if (us < s_SubBuckets) {
+    return us;
+  }
+  // Values in [2^e, 2^(e + 1)) share one row of s_SubBuckets buckets
+  size_t e = 3;
+  while ((us >> (e + 1)) != 0) {
+    e++;
+  }
+  size_t sub    = (us >> (e - 3)) & (s_SubBuckets - 1);
+  size_t bucket = (e - 2) * s_SubBuckets + sub;
+  return std::min(bucket, s_Buckets - 1);
+}
+
+double InputLatency::_bucket_upper_ms(size_t bucket) {
+  if (bucket < s_SubBuckets) {
+    return (double)(bucket + 1) / 1000.0;
+  }
+  size_t e    = bucket / s_SubBuckets + 2;
+  size_t sub  = bucket % s_SubBuckets;
+  uint64_t us = (uint64_t)(s_SubBuckets + sub + 1) << (e - 3);
+  return (double)us / 1000.0;
+}
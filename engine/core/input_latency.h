@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CORE_INPUT_LATENCY_H
+#define CORE_INPUT_LATENCY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Rolling histogram of input to present latency.
+//
+// Samples land in log scale microsecond buckets (8 per power of two, so a
+// percentile is within 12.5% of the real value) of the current time slice,
+// the oldest of the s_Slices slices is dropped when a new one starts. Slices
+// move on with the frame clock through advance(), so the window also empties
+// once input stops.
+// Recording is a bucket lookup and an increment without allocating, so it
+// stays enabled in every build. Not thread safe, used from the thread
+// calling Input::poll_events.
+class InputLatency {
+public:
+  static constexpr size_t s_SubBuckets = 8;
+  static constexpr size_t s_Buckets    = 24 * s_SubBuckets;
+  static constexpr size_t s_Slices     = 8;
+
+  struct Summary {
+    uint64_t count = 0;
+    double p50_ms  = 0.0;
+    double p95_ms  = 0.0;
+    double p99_ms  = 0.0;
+    double max_ms  = 0.0;
+  };
+
+public:
+  // - slice_ms: Length of a slice, the window covers s_Slices of them
+  InputLatency(uint32_t slice_ms = 1000);
+
+  // Starts the slices that began up to now_ns, clearing them. Called every
+  // frame, record does it as well
+  void advance(uint64_t now_ns);
+  void record(uint64_t latency_ns, uint64_t now_ns);
+  void reset();
+
+  // Percentiles over the whole window
+  Summary summary() const;
+  void log() const;
+
+private:
+  static size_t _bucket(uint64_t us);
+  static double _bucket_upper_ms(size_t bucket);
+
+private:
+  uint64_t _slice_ns       = 0;
+  uint64_t _slice_begin_ns = 0;
+  size_t _slice            = 0;
+
+  uint32_t _counts[s_Slices][s_Buckets];
+  uint64_t _max_ns[s_Slices];
+};
+
+#endif
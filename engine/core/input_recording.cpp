@@ -0,0 +1,126 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input_recording.h"
+#include "core/console.h"
+#include "core/input_events.h"
+#include <string>
+
+InputRecorder::InputRecorder(const std::string_view& path) {
+  std::string path_str(path);
+  _file = std::fopen(path_str.c_str(), "wb");
+  if (_file == nullptr) {
+    CONTEXT_ERROR("INPUT", "Failed to open input recording '{}'", path);
+    return;
+  }
+
+  InputRecordHeader header;
+  std::fwrite(&header, sizeof(header), 1, _file);
+  _block.reserve(s_BlockEvents);
+  _start_ns = input_time_ns();
+}
+
+InputRecorder::~InputRecorder() {
+  if (_file != nullptr) {
+    _flush();
+    std::fclose(_file);
+  }
+}
+
+void InputRecorder::record(const InputRecordEvent& event) {
+  if (_file == nullptr) {
+    return;
+  }
+
+  InputRecordEvent& recorded = _block.emplace_back(event);
+  recorded.time_ns           = event.time_ns - _start_ns;
+  if (_block.size() == s_BlockEvents) {
+    _flush();
+  }
+}
+
+void InputRecorder::finish(uint32_t last_frame) {
+  if (_file == nullptr) {
+    return;
+  }
+
+  record(InputRecordEvent::make(input_time_ns(), last_frame,
+                                InputRecordType_End, 0, 0, 0));
+  _flush();
+  std::fclose(_file);
+  _file = nullptr;
+}
+
+void InputRecorder::_flush() {
+  if (!_block.empty()) {
+    std::fwrite(_block.data(), sizeof(InputRecordEvent), _block.size(),
+                _file);
+    _block.clear();
+  }
+}
+
+InputReplay::InputReplay(const std::string_view& path) {
+  std::string path_str(path);
+  FILE* file = std::fopen(path_str.c_str(), "rb");
+  if (file == nullptr) {
+    CONTEXT_ERROR("INPUT", "Failed to open input recording '{}'", path);
+    return;
+  }
+
+  InputRecordHeader header;
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == InputRecordHeader::s_Magic &&
+               header.version == InputRecordHeader::s_Version;
+  if (!valid) {
+    CONTEXT_ERROR("INPUT", "'{}' is not an input recording", path);
+    std::fclose(file);
+    return;
+  }
+
+  InputRecordEvent event;
+  while (std::fread(&event, sizeof(event), 1, file) == 1) {
+    if (event.type == InputRecordType_End) {
+      _last_frame = event.frame;
+      _valid      = true;
+      break;
+    }
+    _events.push_back(event);
+  }
+  std::fclose(file);
+
+  if (!_valid) {
+    CONTEXT_WARN("INPUT", "'{}' is truncated, replaying up to its last event",
+                 path);
+    _last_frame = _events.empty() ? 0 : _events.back().frame;
+    _valid      = true;
+  }
+}
+
+uint64_t InputReplay::duration_ns() const {
+  return _events.empty() ? 0 : _events.back().time_ns - _events.front().time_ns;
+}
+
+const InputRecordEvent* InputReplay::next_frame(uint32_t frame,
+                                                size_t* count) {
+  while (_cursor < _events.size() && _events[_cursor].frame < frame) {
+    _cursor++;
+  }
+  size_t begin = _cursor;
+  while (_cursor < _events.size() && _events[_cursor].frame == frame) {
+    _cursor++;
+  }
+  *count = _cursor - begin;
+  return _events.data() + begin;
+}
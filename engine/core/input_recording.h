@@ -0,0 +1,167 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CORE_INPUT_RECORDING_H
+#define CORE_INPUT_RECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+// Input recording stream
+//
+// The stream starts with an InputRecordHeader followed by fixed size
+// InputRecordEvent entries in the order Input received them, using host byte
+// order. Buttons are recorded as press and release events, analog state
+// (gamepad axes, cursor and scroll) as an event whenever it changes, starting
+// with the state at the start of the recording. The last entry of a complete
+// recording is an End event holding the last recorded frame, a stream without
+// one (the process died while recording) ends after its last event.
+
+enum InputRecordType : uint8_t {
+  InputRecordType_Key           = 1,
+  InputRecordType_MouseButton   = 2,
+  InputRecordType_GamepadButton = 3,
+  InputRecordType_End           = 4,
+  InputRecordType_Char          = 5,
+  InputRecordType_GamepadAxis   = 6,
+  InputRecordType_CursorPos     = 7,
+  InputRecordType_Scroll        = 8,
+};
+
+struct InputRecordHeader {
+  static constexpr uint32_t s_Magic   = 0x4e495746;  // "FWIN"
+  static constexpr uint32_t s_Version = 2;
+
+  uint32_t magic   = s_Magic;
+  uint32_t version = s_Version;
+};
+
+struct InputRecordEvent {
+  // Nanoseconds since the recording started, only informational as replay
+  // is driven by frame
+  uint64_t time_ns = 0;
+  // Input::frame() of the poll_events that received the event
+  uint32_t frame = 0;
+  // KeyCode, MouseButton or GamepadJoystick << 8 | GamepadButton, or
+  // GamepadAxis in place of the button. Char events store the low 16 bits
+  // of the codepoint here
+  int16_t code = 0;
+  uint8_t type   = 0;  // InputRecordType
+  // GLFW action in the low 2 bits, KeyMod bits above it. Char events store
+  // the upper 5 bits of the codepoint here
+  uint8_t action_mods = 0;
+  // Raw GLFW axis value in x, cursor position or scroll offset in both
+  float x = 0.0f;
+  float y = 0.0f;
+
+  static inline InputRecordEvent make(uint64_t time_ns, uint32_t frame,
+                                      InputRecordType type, int code,
+                                      int action, int mods) {
+    InputRecordEvent event;
+    event.time_ns     = time_ns;
+    event.frame       = frame;
+    event.code        = (int16_t)code;
+    event.type        = type;
+    event.action_mods = (uint8_t)((action & 0x3) | (mods << 2));
+    return event;
+  }
+
+  static inline InputRecordEvent make_char(uint64_t time_ns, uint32_t frame,
+                                           char32_t codepoint) {
+    InputRecordEvent event;
+    event.time_ns     = time_ns;
+    event.frame       = frame;
+    event.code        = (int16_t)(codepoint & 0xffff);
+    event.type        = InputRecordType_Char;
+    event.action_mods = (uint8_t)((codepoint >> 16) & 0x1f);
+    return event;
+  }
+
+  static inline InputRecordEvent make_value(uint64_t time_ns, uint32_t frame,
+                                            InputRecordType type, int code,
+                                            float x, float y) {
+    InputRecordEvent event;
+    event.time_ns = time_ns;
+    event.frame   = frame;
+    event.code    = (int16_t)code;
+    event.type    = type;
+    event.x       = x;
+    event.y       = y;
+    return event;
+  }
+
+  inline int action() const { return action_mods & 0x3; }
+  inline int mods() const { return action_mods >> 2; }
+  inline char32_t codepoint() const {
+    return (char32_t)(uint16_t)code | ((char32_t)action_mods << 16);
+  }
+};
+
+static_assert(sizeof(InputRecordEvent) == 24,
+              "InputRecordEvent is stored as is in the stream");
+
+// Buffers events in memory and writes them out in blocks, so recording does
+// not add a write call to frames with input
+class InputRecorder {
+public:
+  InputRecorder(const std::string_view& path);
+  ~InputRecorder();
+
+  inline bool valid() const { return _file != nullptr; }
+
+  // - event: time_ns is input_time_ns() and frame is relative to the start
+  //   of the recording
+  void record(const InputRecordEvent& event);
+  // Writes the End event and closes the stream
+  void finish(uint32_t last_frame);
+
+private:
+  void _flush();
+
+private:
+  static constexpr size_t s_BlockEvents = 256;
+
+  FILE* _file = nullptr;
+  uint64_t _start_ns = 0;
+  std::vector<InputRecordEvent> _block;
+};
+
+// Loads a whole recording and hands its events back one frame at a time
+class InputReplay {
+public:
+  InputReplay(const std::string_view& path);
+
+  inline bool valid() const { return _valid; }
+  inline uint32_t last_frame() const { return _last_frame; }
+  inline size_t event_count() const { return _events.size(); }
+  // Recorded wall time between the first and last event
+  uint64_t duration_ns() const;
+
+  // Events recorded during frame, frames have to be requested in increasing
+  // order
+  const InputRecordEvent* next_frame(uint32_t frame, size_t* count);
+  // The frame passed the last recorded frame
+  inline bool finished(uint32_t frame) const { return frame > _last_frame; }
+
+private:
+  std::vector<InputRecordEvent> _events;
+  size_t _cursor       = 0;
+  uint32_t _last_frame = 0;
+  bool _valid          = false;
+};
+
+#endif
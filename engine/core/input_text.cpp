@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input_text.h"
+#include "core/cstr_utils.h"
+
+int input_char_flags(char32_t codepoint) {
+  using namespace fiwre;
+  int flags = InputChar_NoneBit;
+  flags |= is_upper_case(codepoint) ? InputChar_UpperCaseBit : 0;
+  flags |= is_lower_case(codepoint) ? InputChar_LowerCaseBit : 0;
+  flags |= is_digit(codepoint) ? InputChar_DigitBit : 0;
+  flags |= is_hex_digit(codepoint) ? InputChar_HexDigitBit : 0;
+  flags |= is_alphabet_char(codepoint) ? InputChar_AlphabetBit : 0;
+  flags |= is_identifier(codepoint) ? InputChar_IdentifierBit : 0;
+  flags |= is_whitespace(codepoint) ? InputChar_WhitespaceBit : 0;
+  flags |= is_linebreak(codepoint) ? InputChar_LinebreakBit : 0;
+  flags |= is_punctuation(codepoint) ? InputChar_PunctuationBit : 0;
+  flags |= is_control(codepoint) ? InputChar_ControlBit : 0;
+  return flags;
+}
+
+void InputTextBuffer::push(char32_t codepoint, uint32_t frame) {
+  if (size() == s_Capacity) {
+    _dropped++;
+    return;
+  }
+  InputTextChar& ch = _chars[_tail++ & (s_Capacity - 1)];
+  ch.codepoint      = codepoint;
+  ch.frame          = frame;
+  ch.flags          = input_char_flags(codepoint);
+}
+
+size_t InputTextBuffer::drain(InputTextChar* out, size_t max) {
+  size_t count = 0;
+  for (; count < max && _head != _tail; count++, _head++) {
+    out[count] = _chars[_head & (s_Capacity - 1)];
+  }
+  return count;
+}
+
+void InputTextBuffer::discard_before(uint32_t frame) {
+  while (_head != _tail && _chars[_head & (s_Capacity - 1)].frame < frame) {
+    _head++;
+  }
+}
+
+void InputTextBuffer::clear() {
+  _head = _tail;
+}
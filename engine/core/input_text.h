@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CORE_INPUT_TEXT_H
+#define CORE_INPUT_TEXT_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum InputCharFlags {
+  InputChar_NoneBit        = 0,
+  InputChar_UpperCaseBit   = 1 << 0,
+  InputChar_LowerCaseBit   = 1 << 1,
+  InputChar_DigitBit       = 1 << 2,
+  InputChar_HexDigitBit    = 1 << 3,
+  InputChar_AlphabetBit    = 1 << 4,
+  InputChar_IdentifierBit  = 1 << 5,
+  InputChar_WhitespaceBit  = 1 << 6,
+  InputChar_LinebreakBit   = 1 << 7,
+  InputChar_PunctuationBit = 1 << 8,
+  InputChar_ControlBit     = 1 << 9,
+};
+
+// InputCharFlags of a codepoint, using the helpers in core/cstr_utils.h
+int input_char_flags(char32_t codepoint);
+
+struct InputTextChar {
+  char32_t codepoint = 0;
+  uint32_t frame     = 0;  // Input::frame() of the poll_events it arrived in
+  int flags          = InputChar_NoneBit;
+};
+
+// Fixed ring of the characters typed, in the order GLFW reported them.
+//
+// Characters are classified once when they arrive and drained by copying
+// into caller storage, so typing never allocates. A character is readable
+// during the frame after the poll_events it arrived in, Input discards the
+// ones nobody drained when the next frame's events come in. When the ring is
+// full new characters are dropped, keeping what was typed first intact.
+class InputTextBuffer {
+public:
+  static constexpr size_t s_Capacity = 256;
+  static_assert((s_Capacity & (s_Capacity - 1)) == 0,
+                "Capacity has to be a power of two");
+
+public:
+  inline size_t size() const { return _tail - _head; }
+  inline bool empty() const { return _tail == _head; }
+  inline uint64_t dropped() const { return _dropped; }
+
+  void push(char32_t codepoint, uint32_t frame);
+  // Removes up to max characters and copies them into out in order,
+  // returns how many were copied
+  size_t drain(InputTextChar* out, size_t max);
+  // Calls func(const InputTextChar&) for every character and removes them
+  template <typename TFunc>
+  void drain(TFunc&& func) {
+    for (; _head != _tail; _head++) {
+      func(_chars[_head & (s_Capacity - 1)]);
+    }
+  }
+  // Discards the characters that arrived before frame
+  void discard_before(uint32_t frame);
+  void clear();
+
+private:
+  InputTextChar _chars[s_Capacity];
+  size_t _head      = 0;
+  size_t _tail      = 0;
+  uint64_t _dropped = 0;
+};
+
+#endif
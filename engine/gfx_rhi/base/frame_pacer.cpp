@@ -0,0 +1,153 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/frame_pacer.h"
+#include "core/console.h"
+#include "gfx_rhi/window_handle.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static uint64_t _now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static double _to_ms(uint64_t ns) {
+  return (double)ns / 1e6;
+}
+
+FramePacer::FramePacer(WindowHandle* window, const FramePacerConfig& config)
+    : _window_ptr(window), _config(config) {
+  set_target_fps(config.target_fps);
+}
+
+void FramePacer::set_target_fps(double fps) {
+  _config.target_fps = fps;
+  _period_ns         = fps > 0.0 ? (uint64_t)(1e9 / fps) : 0;
+  _deadline_ns       = 0;
+}
+
+void FramePacer::set_wait_callback(FramePacerWaitCallback callback,
+                                   void* user_data) {
+  _wait_callback  = callback;
+  _wait_user_data = user_data;
+}
+
+void FramePacer::present() {
+  uint64_t begin         = _now_ns();
+  FramePacerStats& stats = _history[_frame % s_History];
+  stats                  = FramePacerStats();
+  stats.frame            = _frame;
+  if (_last_present_ns != 0) {
+    stats.work_ms = _to_ms(begin - _last_present_ns);
+  }
+
+  if (_period_ns > 0) {
+    _deadline_ns = _deadline_ns == 0 ? begin : _deadline_ns + _period_ns;
+    if (begin > _deadline_ns) {
+      // Start a new phase from here rather than rushing the next frames
+      stats.missed = true;
+      _deadline_ns = begin;
+    } else {
+      _wait_until(_deadline_ns, stats);
+    }
+  }
+
+  uint64_t swap_begin = _now_ns();
+  _window_ptr->swap_buffers();
+  uint64_t end  = _now_ns();
+  stats.swap_ms = _to_ms(end - swap_begin);
+
+  if (_last_present_ns != 0) {
+    stats.frame_ms = _to_ms(end - _last_present_ns);
+    _smoothed_ms   = _smoothed_ms == 0.0
+                         ? stats.frame_ms
+                         : _smoothed_ms + _config.smoothing *
+                                              (stats.frame_ms - _smoothed_ms);
+  }
+  _last_present_ns = end;
+  _frame++;
+}
+
+void FramePacer::log() const {
+  size_t count = (size_t)std::min<uint64_t>(_frame, s_History);
+  if (count == 0) {
+    return;
+  }
+
+  double frame_ms[s_History];
+  size_t missed = 0;
+  for (size_t i = 0; i < count; i++) {
+    frame_ms[i] = history(i).frame_ms;
+    missed += history(i).missed;
+  }
+  std::sort(frame_ms, frame_ms + count);
+  auto percentile = [&](double p) {
+    return frame_ms[(size_t)(p * (double)(count - 1))];
+  };
+  RHI_INFO("Last {} frames: p50 {:.2f}ms, p95 {:.2f}ms, p99 {:.2f}ms, max "
+           "{:.2f}ms, {} missed the {:.1f} FPS target",
+           count, percentile(0.50), percentile(0.95), percentile(0.99),
+           frame_ms[count - 1], missed, _config.target_fps);
+}
+
+void FramePacer::_wait_until(uint64_t deadline_ns, FramePacerStats& stats) {
+  // Sleeping is only precise to the scheduler's granularity, so stop early
+  // by at least the amount the recent sleeps overslept
+  double spin_ms   = std::max(_config.spin_ms, _oversleep_ms * 1.5);
+  uint64_t spin_ns = (uint64_t)(spin_ms * 1e6);
+
+  // Without a callback there is nothing to wake up for before the end
+  uint64_t slice_ns = _wait_callback != nullptr
+                          ? (uint64_t)(_config.wait_callback_ms * 1e6)
+                          : UINT64_MAX;
+
+  uint64_t now = _now_ns();
+  if (now + spin_ns < deadline_ns) {
+    uint64_t wake_ns     = deadline_ns - spin_ns;
+    uint64_t sleep_begin = now;
+    uint64_t oversleep   = 0;
+    while (now < wake_ns) {
+      _call_wait_callback();
+      now = _now_ns();
+      if (now >= wake_ns) {
+        break;
+      }
+      uint64_t slice_end = wake_ns - now > slice_ns ? now + slice_ns : wake_ns;
+      std::this_thread::sleep_for(std::chrono::nanoseconds(slice_end - now));
+      now       = _now_ns();
+      oversleep = now > slice_end ? now - slice_end : 0;
+    }
+    stats.sleep_ms = _to_ms(now - sleep_begin);
+    _oversleep_ms += 0.1 * (_to_ms(oversleep) - _oversleep_ms);
+  }
+
+  uint64_t spin_begin = now;
+  // No callbacks here, the spin is short and has to end on time
+  while (now < deadline_ns) {
+    std::this_thread::yield();
+    now = _now_ns();
+  }
+  stats.spin_ms     = _to_ms(now - spin_begin);
+  stats.lateness_ms = _to_ms(now - deadline_ns);
+}
+
+void FramePacer::_call_wait_callback() {
+  if (_wait_callback != nullptr) {
+    _wait_callback(_wait_user_data);
+  }
+}
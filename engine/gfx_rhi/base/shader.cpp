@@ -0,0 +1,256 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/shader.h"
+#include "core/console.h"
+#include "core/cstr_utils.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fmt/format.h>
+
+uint64_t shader_hash(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t hash        = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+uint64_t shader_hash(const std::vector<ShaderStageSource>& stages) {
+  uint64_t hash = shader_hash(nullptr, 0);
+  for (const ShaderStageSource& stage : stages) {
+    uint32_t type = (uint32_t)stage.stage;
+    hash          = shader_hash(&type, sizeof(type), hash);
+    hash          = shader_hash(stage.source.data(), stage.source.size(), hash);
+  }
+  return hash;
+}
+
+static bool _read_file(const std::filesystem::path& path, std::string& text) {
+  FILE* file = std::fopen(path.string().c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  char buffer[4096];
+  size_t read = 0;
+  while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text.append(buffer, read);
+  }
+  bool valid = std::ferror(file) == 0;
+  std::fclose(file);
+  return valid;
+}
+
+// Matches `#include "file"` and `#include <file>`
+static bool _parse_include(std::string_view line, std::string_view& include) {
+  auto skip_spaces = [&line]() {
+    while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+      line.remove_prefix(1);
+    }
+  };
+  skip_spaces();
+  if (line.empty() || line.front() != '#') {
+    return false;
+  }
+  line.remove_prefix(1);
+  skip_spaces();
+  if (line.compare(0, 7, "include") != 0) {
+    return false;
+  }
+  line.remove_prefix(7);
+  skip_spaces();
+  if (line.empty() || (line.front() != '"' && line.front() != '<')) {
+    return false;
+  }
+  char close = line.front() == '"' ? '"' : '>';
+  size_t end = line.find(close, 1);
+  if (end == std::string_view::npos) {
+    return false;
+  }
+  include = line.substr(1, end - 1);
+  return true;
+}
+
+static bool _append_source(const std::filesystem::path& path,
+                           ShaderStageSource& result) {
+  std::string text;
+  if (!_read_file(path, text)) {
+    RHI_ERROR("Cannot read shader source '{}'", path.string());
+    return false;
+  }
+  size_t index = result.files.size();
+  result.files.push_back(path.string());
+
+  size_t line  = 1;
+  size_t begin = 0;
+  while (begin < text.size()) {
+    size_t end = std::min(text.find('\n', begin), text.size());
+    std::string_view str(text.data() + begin, end - begin);
+    std::string_view include;
+    if (!_parse_include(str, include)) {
+      result.source.append(str);
+      result.source += '\n';
+    } else {
+      std::filesystem::path include_path =
+          (path.parent_path() / include).lexically_normal();
+      if (std::find(result.files.begin(), result.files.end(),
+                    include_path.string()) != result.files.end()) {
+        // Already included, the blank line keeps the numbering
+        result.source += '\n';
+      } else {
+        result.source += fmt::format("#line 1 {}\n", result.files.size());
+        if (!_append_source(include_path, result)) {
+          return false;
+        }
+        result.source += fmt::format("#line {} {}\n", line + 1, index);
+      }
+    }
+    begin = end + 1;
+    line++;
+  }
+  return true;
+}
+
+bool shader_load_source(const std::string_view& path, ShaderStage stage,
+                        ShaderStageSource& result) {
+  result.stage = stage;
+  result.path  = std::string(path);
+  result.source.clear();
+  result.files.clear();
+  return _append_source(std::filesystem::path(result.path).lexically_normal(),
+                        result);
+}
+
+std::string shader_map_log(const std::string_view& log,
+                           const std::vector<std::string>& files) {
+  if (files.empty()) {
+    return std::string(log);
+  }
+
+  // Drivers start error lines with "0:12(4):" (Mesa), "ERROR: 0:12:" (AMD)
+  // or "0(12) :" (NVIDIA), where 0 is the source string number
+  std::string result;
+  size_t begin = 0;
+  while (begin < log.size()) {
+    size_t end = std::min(log.find('\n', begin), log.size() - 1) + 1;
+    std::string_view line = log.substr(begin, end - begin);
+    begin                 = end;
+
+    size_t at = 0;
+    for (std::string_view prefix : {"ERROR: ", "WARNING: "}) {
+      if (line.compare(0, prefix.size(), prefix) == 0) {
+        at = prefix.size();
+      }
+    }
+    size_t number_end = at;
+    while (number_end < line.size() && fiwre::is_digit(line[number_end])) {
+      number_end++;
+    }
+    size_t index = files.size();
+    std::from_chars(line.data() + at, line.data() + number_end, index);
+    if (number_end == at || index >= files.size() ||
+        number_end == line.size() ||
+        (line[number_end] != ':' && line[number_end] != '(')) {
+      result.append(line);
+      continue;
+    }
+
+    result.append(line.substr(0, at));
+    result += files[index];
+    size_t close = line.find(')', number_end);
+    if (line[number_end] == '(' && close != std::string_view::npos) {
+      result += ':';
+      result.append(line.substr(number_end + 1, close - number_end - 1));
+      result.append(line.substr(close + 1));
+    } else {
+      result.append(line.substr(number_end));
+    }
+  }
+  return result;
+}
+
+std::string_view shader_stage_to_string(ShaderStage stage) {
+  switch (stage) {
+  case ShaderStage_Vertex:
+    return std::string_view("Vertex");
+  case ShaderStage_TessControl:
+    return std::string_view("Tessellation Control");
+  case ShaderStage_TessEvaluation:
+    return std::string_view("Tessellation Evaluation");
+  case ShaderStage_Geometry:
+    return std::string_view("Geometry");
+  case ShaderStage_Fragment:
+    return std::string_view("Fragment");
+  case ShaderStage_Compute:
+    return std::string_view("Compute");
+  default:
+    return std::string_view("Unknown");
+  }
+}
+
+ShaderProgram::ShaderProgram(ShaderProgram&& other)
+    : _handle(other._handle), _source_hash(other._source_hash),
+      _reflection(std::move(other._reflection)) {
+  other._handle = 0;
+}
+
+ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) {
+  if (this != &other) {
+    destroy();
+    _handle       = other._handle;
+    _source_hash  = other._source_hash;
+    _reflection   = std::move(other._reflection);
+    other._handle = 0;
+  }
+  return *this;
+}
+
+ShaderProgram::~ShaderProgram() {
+  destroy();
+}
+
+std::string ShaderCache::_binary_path(uint64_t source_hash) const {
+  return fmt::format("{}/{:016x}.bin", _directory, source_hash);
+}
+
+ShaderStatus ShaderCache::status(ShaderHandle handle) const {
+  return handle < _entries.size() ? _entries[handle].status
+                                  : ShaderStatus_Failed;
+}
+
+const ShaderProgram* ShaderCache::program(ShaderHandle handle) const {
+  return status(handle) == ShaderStatus_Ready ? &_entries[handle].program
+                                              : nullptr;
+}
+
+uint32_t ShaderCache::generation(ShaderHandle handle) const {
+  return handle < _entries.size() ? _entries[handle].generation : 0;
+}
+
+bool ShaderCache::bind(ShaderHandle handle) const {
+  const ShaderProgram* program = this->program(handle);
+  if (program == nullptr) {
+    program = this->program(_fallback);
+  }
+  if (program == nullptr) {
+    return false;
+  }
+  program->bind();
+  return true;
+}
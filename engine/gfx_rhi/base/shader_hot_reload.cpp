@@ -0,0 +1,257 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/shader_hot_reload.h"
+#include "core/console.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#ifdef __linux__
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static std::string _absolute_path(const fs::path& path) {
+  std::error_code error;
+  fs::path absolute = fs::absolute(path, error);
+  return (error ? path : absolute).lexically_normal().string();
+}
+
+ShaderHotReload::ShaderHotReload(ShaderCache* cache) : _cache(cache) {}
+
+ShaderHotReload::~ShaderHotReload() {
+  if (_thread.joinable()) {
+    _running = false;
+    _thread.join();
+  }
+#ifdef __linux__
+  if (_inotify != -1) {
+    close(_inotify);
+  }
+#endif
+}
+
+ShaderHandle
+    ShaderHotReload::load(const std::vector<ShaderStageFile>& files) {
+  std::vector<ShaderStageSource> stages;
+  if (!_load_sources(files, stages)) {
+    return ShaderCache::s_InvalidHandle;
+  }
+
+  // Programs that fail to build stay registered, fixing the file reloads them
+  ShaderHandle handle = _cache->submit(stages);
+  Program program;
+  program.handle = handle;
+  program.files  = files;
+  _add(std::move(program), stages);
+  return handle;
+}
+
+ShaderPermutations* ShaderHotReload::load_permutations(
+    const std::vector<ShaderStageFile>& files,
+    std::vector<std::string> features) {
+  std::vector<ShaderStageSource> stages;
+  if (!_load_sources(files, stages)) {
+    return nullptr;
+  }
+
+  ShaderPermutations* permutations = new ShaderPermutations(
+      _cache, stages, std::move(features));
+  _permutations.emplace_back(permutations);
+
+  Program program;
+  program.permutations = permutations;
+  program.files        = files;
+  _add(std::move(program), stages);
+  return permutations;
+}
+
+size_t ShaderHotReload::update() {
+  std::vector<Reload> reloads;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    reloads.swap(_reloads);
+  }
+  for (Reload& reload : reloads) {
+    if (reload.permutations != nullptr) {
+      reload.permutations->reload(std::move(reload.stages));
+    } else {
+      _cache->rebuild(reload.handle, reload.stages);
+    }
+  }
+  return reloads.size();
+}
+
+bool ShaderHotReload::_load_sources(const std::vector<ShaderStageFile>& files,
+                                    std::vector<ShaderStageSource>& stages) {
+  stages.resize(files.size());
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!shader_load_source(files[i].path, files[i].stage, stages[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ShaderHotReload::_add(Program program,
+                           const std::vector<ShaderStageSource>& stages) {
+  program.dependencies = _dependencies(stages);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _programs.push_back(std::move(program));
+}
+
+void ShaderHotReload::_reload(std::vector<std::string>& changed) {
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+  // Programs are only ever appended, the indices stay valid while the
+  // sources are read without holding the lock
+  std::vector<std::pair<size_t, std::vector<ShaderStageFile>>> affected;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _programs.size(); i++) {
+      const std::vector<std::string>& dependencies = _programs[i].dependencies;
+      for (const std::string& path : changed) {
+        if (std::binary_search(dependencies.begin(), dependencies.end(),
+                               path)) {
+          affected.emplace_back(i, _programs[i].files);
+          break;
+        }
+      }
+    }
+  }
+
+  for (const auto& [index, files] : affected) {
+    Reload reload;
+    if (!_load_sources(files, reload.stages)) {
+      continue;
+    }
+    RHI_INFO("Reloading shader '{}'", files.front().path);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Program& program     = _programs[index];
+    program.dependencies = _dependencies(reload.stages);
+    reload.handle        = program.handle;
+    reload.permutations  = program.permutations;
+    _reloads.push_back(std::move(reload));
+  }
+}
+
+std::vector<std::string> ShaderHotReload::_dependencies(
+    const std::vector<ShaderStageSource>& stages) {
+  std::vector<std::string> dependencies;
+  for (const ShaderStageSource& stage : stages) {
+    for (const std::string& file : stage.files) {
+      dependencies.push_back(_absolute_path(file));
+    }
+  }
+  std::sort(dependencies.begin(), dependencies.end());
+  dependencies.erase(std::unique(dependencies.begin(), dependencies.end()),
+                     dependencies.end());
+  return dependencies;
+}
+
+#ifdef __linux__
+
+bool ShaderHotReload::watch(const std::string_view& directory) {
+  if (_inotify == -1) {
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    RHI_CONDITION_ERROR_RETURN(_inotify != -1, false,
+                               "Cannot watch shader sources: {}",
+                               std::strerror(errno));
+  }
+
+  std::vector<fs::path> directories = {fs::path(directory)};
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(directory, error), end;
+       !error && it != end; it.increment(error)) {
+    if (it->is_directory(error)) {
+      directories.push_back(it->path());
+    }
+  }
+  RHI_CONDITION_ERROR_RETURN(!error, false, "Cannot watch '{}': {}",
+                             directory, error.message());
+
+  // Editors either rewrite the file or write a new one and rename it over
+  const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const fs::path& path : directories) {
+      int handle = inotify_add_watch(_inotify, path.c_str(), mask);
+      if (handle == -1) {
+        RHI_WARN("Cannot watch '{}': {}", path.string(),
+                 std::strerror(errno));
+        continue;
+      }
+      _directories[handle] = _absolute_path(path);
+    }
+  }
+
+  if (!_thread.joinable()) {
+    _running = true;
+    _thread  = std::thread(&ShaderHotReload::_run, this);
+  }
+  return true;
+}
+
+void ShaderHotReload::_run() {
+  alignas(inotify_event) char buffer[4096];
+  std::vector<std::string> changed;
+  while (_running) {
+    // A save is often several events, they settle before anything reloads
+    pollfd fd  = {.fd = _inotify, .events = POLLIN, .revents = 0};
+    int events = ::poll(&fd, 1, changed.empty() ? 100 : 50);
+    if (events <= 0) {
+      if (!changed.empty()) {
+        _reload(changed);
+        changed.clear();
+      }
+      continue;
+    }
+
+    ssize_t size = read(_inotify, buffer, sizeof(buffer));
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (ssize_t at = 0; at < size;) {
+      const inotify_event* event = (const inotify_event*)(buffer + at);
+      at += (ssize_t)(sizeof(inotify_event) + event->len);
+      if (event->len == 0 || (event->mask & IN_ISDIR)) {
+        continue;
+      }
+      auto directory = _directories.find(event->wd);
+      if (directory != _directories.end()) {
+        changed.push_back(
+            (fs::path(directory->second) / event->name).string());
+      }
+    }
+  }
+}
+
+#else
+
+bool ShaderHotReload::watch(const std::string_view& directory) {
+  RHI_WARN("Shader hot reload is not supported on this platform, '{}' is "
+           "not watched",
+           directory);
+  return false;
+}
+
+void ShaderHotReload::_run() {}
+
+#endif
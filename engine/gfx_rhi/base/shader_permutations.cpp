@@ -0,0 +1,134 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/shader_permutations.h"
+#include "core/console.h"
+#include <cinttypes>
+#include <cstdio>
+
+// Offset just past the #version directive's line, 0 without one. Comments and
+// blank lines may come before it
+// - line: Set to the 1 based number of the line at the returned offset
+static size_t _after_version(const std::string& source, size_t* line) {
+  size_t begin = 0;
+  for (size_t number = 1; begin < source.size(); number++) {
+    size_t end = source.find('\n', begin);
+    end        = end == std::string::npos ? source.size() : end;
+
+    size_t token = source.find_first_not_of(" \t", begin);
+    if (token < end && source[token] == '#') {
+      token = source.find_first_not_of(" \t", token + 1);
+      if (token < end && source.compare(token, 7, "version") == 0) {
+        *line = number + 1;
+        return end == source.size() ? end : end + 1;
+      }
+    }
+    begin = end + 1;
+  }
+  *line = 1;
+  return 0;
+}
+
+ShaderPermutations::ShaderPermutations(ShaderCache* cache,
+                                       std::vector<ShaderStageSource> stages,
+                                       std::vector<std::string> features)
+    : _cache(cache), _stages(std::move(stages)),
+      _features(std::move(features)) {
+  if (_features.size() > s_MaxFeatures) {
+    RHI_ERROR("Shader has {} features, only the first {} are used",
+              _features.size(), s_MaxFeatures);
+    _features.resize(s_MaxFeatures);
+  }
+  _handles.resize((size_t)1 << _features.size(), ShaderCache::s_InvalidHandle);
+}
+
+ShaderHandle ShaderPermutations::handle(ShaderPermutationKey key) {
+  if (key >= _handles.size()) {
+    return ShaderCache::s_InvalidHandle;
+  }
+  ShaderHandle& handle = _handles[key];
+  if (handle == ShaderCache::s_InvalidHandle) {
+    handle = _cache->submit(sources(key));
+  }
+  return handle;
+}
+
+bool ShaderPermutations::bind(ShaderPermutationKey key) {
+  return _cache->bind(handle(key));
+}
+
+std::vector<ShaderStageSource>
+    ShaderPermutations::sources(ShaderPermutationKey key) const {
+  std::string defines;
+  for (size_t i = 0; i < _features.size(); i++) {
+    if (key & (1u << i)) {
+      defines += "#define " + _features[i] + " 1\n";
+    }
+  }
+
+  std::vector<ShaderStageSource> result = _stages;
+  for (ShaderStageSource& stage : result) {
+    // #version has to stay the first statement, #line keeps the line numbers
+    // in compile errors matching the file
+    size_t line   = 1;
+    size_t insert = _after_version(stage.source, &line);
+    stage.source.insert(insert, defines + "#line " + std::to_string(line) +
+                                    "\n");
+  }
+  return result;
+}
+
+size_t ShaderPermutations::reload(std::vector<ShaderStageSource> stages) {
+  _stages      = std::move(stages);
+  size_t count = 0;
+  for (size_t key = 0; key < _handles.size(); key++) {
+    if (_handles[key] != ShaderCache::s_InvalidHandle) {
+      _cache->rebuild(_handles[key], sources((ShaderPermutationKey)key));
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t ShaderPermutations::precompile(const std::string_view& usage_path) {
+  std::string path(usage_path);
+  FILE* file = std::fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  size_t count = 0;
+  ShaderPermutationKey key;
+  while (std::fscanf(file, "%" SCNx32, &key) == 1) {
+    // Keys past the feature count come from an older version of the shader
+    if (handle(key) != ShaderCache::s_InvalidHandle) {
+      count++;
+    }
+  }
+  std::fclose(file);
+  return count;
+}
+
+bool ShaderPermutations::save_usage(const std::string_view& usage_path) const {
+  std::string path(usage_path);
+  FILE* file = std::fopen(path.c_str(), "w");
+  RHI_CONDITION_ERROR_RETURN(file != nullptr, false,
+                             "Cannot write shader usage list '{}'", path);
+  for (size_t key = 0; key < _handles.size(); key++) {
+    if (_handles[key] != ShaderCache::s_InvalidHandle) {
+      std::fprintf(file, "%zx\n", key);
+    }
+  }
+  return std::fclose(file) == 0;
+}
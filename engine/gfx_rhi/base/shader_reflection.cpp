@@ -0,0 +1,159 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/shader_reflection.h"
+#include "core/console.h"
+#include "gfx_rhi/shader.h"
+
+std::string_view shader_data_type_to_string(ShaderDataType type) {
+  switch (type) {
+  case ShaderDataType_Float:
+    return std::string_view("float");
+  case ShaderDataType_Vec2:
+    return std::string_view("vec2");
+  case ShaderDataType_Vec3:
+    return std::string_view("vec3");
+  case ShaderDataType_Vec4:
+    return std::string_view("vec4");
+  case ShaderDataType_Int:
+    return std::string_view("int");
+  case ShaderDataType_IVec2:
+    return std::string_view("ivec2");
+  case ShaderDataType_IVec3:
+    return std::string_view("ivec3");
+  case ShaderDataType_IVec4:
+    return std::string_view("ivec4");
+  case ShaderDataType_UInt:
+    return std::string_view("uint");
+  case ShaderDataType_UVec2:
+    return std::string_view("uvec2");
+  case ShaderDataType_UVec3:
+    return std::string_view("uvec3");
+  case ShaderDataType_UVec4:
+    return std::string_view("uvec4");
+  case ShaderDataType_Bool:
+    return std::string_view("bool");
+  case ShaderDataType_Mat2:
+    return std::string_view("mat2");
+  case ShaderDataType_Mat3:
+    return std::string_view("mat3");
+  case ShaderDataType_Mat4:
+    return std::string_view("mat4");
+  case ShaderDataType_Sampler:
+    return std::string_view("sampler");
+  default:
+    return std::string_view("other");
+  }
+}
+
+// Arrays are reported as "name[0]" and may be looked up as "name"
+static bool _name_equals(const std::string_view& reflected,
+                         const std::string_view& name) {
+  return reflected == name ||
+         (reflected.size() == name.size() + 3 &&
+          reflected.compare(0, name.size(), name) == 0 &&
+          reflected.compare(name.size(), 3, "[0]") == 0);
+}
+
+const ShaderVariable*
+    ShaderBlock::find_member(const std::string_view& name) const {
+  for (const ShaderVariable& member : members) {
+    std::string_view reflected = member.name;
+    if (_name_equals(reflected, name)) {
+      return &member;
+    }
+    // Members of blocks with an instance name start with the block name
+    if (reflected.size() > this->name.size() &&
+        reflected.compare(0, this->name.size(), this->name) == 0 &&
+        reflected[this->name.size()] == '.' &&
+        _name_equals(reflected.substr(this->name.size() + 1), name)) {
+      return &member;
+    }
+  }
+  return nullptr;
+}
+
+const ShaderVariable*
+    ShaderReflection::find_uniform(const std::string_view& name) const {
+  for (const ShaderVariable& uniform : uniforms) {
+    if (_name_equals(uniform.name, name)) {
+      return &uniform;
+    }
+  }
+  return nullptr;
+}
+
+const ShaderBlock*
+    ShaderReflection::find_block(const std::string_view& name) const {
+  for (const ShaderBlock& block : blocks) {
+    if (_name_equals(block.name, name)) {
+      return &block;
+    }
+  }
+  return nullptr;
+}
+
+bool shader_resolve_uniform(const ShaderProgram& program,
+                            const std::string_view& name, ShaderDataType type,
+                            uint32_t& handle, int32_t& location,
+                            uint32_t& count) {
+  const ShaderVariable* uniform = program.reflection().find_uniform(name);
+  RHI_CONDITION_WARN_RETURN(uniform != nullptr && uniform->location != -1,
+                            false, "Shader has no active uniform '{}'", name);
+  RHI_CONDITION_ERROR_RETURN(
+      shader_data_type_compatible(type, uniform->type), false,
+      "Uniform '{}' is a {}, not a {}", name,
+      shader_data_type_to_string(uniform->type),
+      shader_data_type_to_string(type));
+  handle   = program.handle();
+  location = uniform->location;
+  count    = uniform->array_size;
+  return true;
+}
+
+void shader_refresh_uniform(const ShaderCache& cache, uint32_t entry,
+                            const std::string_view& name, ShaderDataType type,
+                            uint32_t& generation, uint32_t& handle,
+                            int32_t& location, uint32_t& count) {
+  const uint32_t current = cache.generation(entry);
+  if (current == generation) {
+    return;
+  }
+  generation                   = current;
+  location                     = -1;
+  const ShaderProgram* program = cache.program(entry);
+  if (program != nullptr &&
+      !shader_resolve_uniform(*program, name, type, handle, location, count)) {
+    location = -1;
+  }
+}
+
+ShaderBlockData::ShaderBlockData(const ShaderBlock& block)
+    : _block(block), _data(block.size, 0) {}
+
+const ShaderVariable*
+    ShaderBlockData::_resolve(const std::string_view& name,
+                              ShaderDataType type) const {
+  const ShaderVariable* member = _block.find_member(name);
+  RHI_CONDITION_WARN_RETURN(member != nullptr, nullptr,
+                            "Block '{}' has no active member '{}'",
+                            _block.name, name);
+  RHI_CONDITION_ERROR_RETURN(shader_data_type_compatible(type, member->type),
+                             nullptr, "Member '{}' of '{}' is a {}, not a {}",
+                             name, _block.name,
+                             shader_data_type_to_string(member->type),
+                             shader_data_type_to_string(type));
+  return member;
+}
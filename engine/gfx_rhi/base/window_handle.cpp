@@ -24,9 +24,13 @@ static void _glfw_error_callback(int error, const char* description) {
   CONTEXT_ERROR("GLFW", "Error Number {}: {}", error, description);
 }
 
-static void _initialize_glfw() {
+static void _initialize_glfw(int flags) {
   CONTEXT_CONDITION_FATAL("GLFW", !s_GlfwInitialized,
                           "Cannot initialize more than one GLFW instance");
+  // The null platform needs no display server
+  glfwInitHint(GLFW_PLATFORM, (flags & WindowHandle_HeadlessBit)
+                                  ? GLFW_PLATFORM_NULL
+                                  : GLFW_ANY_PLATFORM);
   glfwInit();
   glfwSetErrorCallback(_glfw_error_callback);
   s_GlfwInitialized = true;
@@ -41,7 +45,7 @@ static void _destroy_glfw() {
 
 WindowHandle::WindowHandle(const std::string_view& title, int32_t width,
                            int32_t height, int flags) {
-  _initialize_glfw();
+  _initialize_glfw(flags);
   _initialize(title, width, height, flags);
 }
 
@@ -71,8 +75,9 @@ void WindowHandle::destroy() {
   glfwDestroyWindow(_win_ptr);
   _destroy_glfw();
 
-  _win_ptr = nullptr;
-  _opts    = WindowHandle_NoneBit;
+  _win_ptr     = nullptr;
+  _opts        = WindowHandle_NoneBit;
+  _has_context = false;
 }
 
 bool WindowHandle::closing() const {
@@ -80,7 +85,9 @@ bool WindowHandle::closing() const {
 }
 
 void WindowHandle::make_current_context() {
-  glfwMakeContextCurrent(_win_ptr);
+  if (_has_context) {
+    glfwMakeContextCurrent(_win_ptr);
+  }
 }
 
 bool WindowHandle::_valid_options(int opts) {
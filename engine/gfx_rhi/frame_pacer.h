@@ -0,0 +1,109 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GFX_RHI_BASE_FRAME_PACER_H
+#define GFX_RHI_BASE_FRAME_PACER_H
+
+#include <cstddef>
+#include <cstdint>
+
+class WindowHandle;
+
+// Called repeatedly while the pacer waits for a deadline
+using FramePacerWaitCallback = void (*)(void* user_data);
+
+struct FramePacerConfig {
+  // Frames per second to limit to, zero leaves pacing to vsync
+  double target_fps = 0.0;
+  // Least time left before the deadline that is spun instead of slept, the
+  // pacer raises it while the OS keeps oversleeping
+  double spin_ms = 1.0;
+  // Longest sleep between two calls of the wait callback
+  double wait_callback_ms = 1.0;
+  // Weight of a new frame in delta_time(), 1 disables the smoothing
+  double smoothing = 0.1;
+};
+
+// Timing of one paced frame, all in milliseconds
+struct FramePacerStats {
+  uint64_t frame     = 0;
+  double frame_ms    = 0.0;  // Present to present
+  double work_ms     = 0.0;  // Previous present to present() being called
+  double sleep_ms    = 0.0;
+  double spin_ms     = 0.0;
+  double swap_ms     = 0.0;  // Time blocked in swap_buffers, i.e. vsync
+  double lateness_ms = 0.0;  // Past the deadline when the wait ended
+  bool missed        = false;  // The work alone took longer than the budget
+};
+
+// Sits between the main loop and WindowHandle::swap_buffers, call present()
+// instead of swap_buffers.
+//
+// With a target FPS every frame gets a deadline one period after the last
+// one. The pacer sleeps until shortly before it and spins the rest, so the
+// core is only busy for the last bit of the wait while the wake up stays
+// precise. A frame that misses its deadline moves the following deadlines
+// instead of trying to catch up with short frames.
+class FramePacer {
+public:
+  static constexpr size_t s_History = 256;
+
+public:
+  FramePacer(WindowHandle* window,
+             const FramePacerConfig& config = FramePacerConfig());
+
+  inline const FramePacerConfig& config() const { return _config; }
+  void set_target_fps(double fps);
+  // Lets the main loop do work during the wait, e.g. Input::pump_events so
+  // events are timestamped when they arrive rather than at the next frame
+  void set_wait_callback(FramePacerWaitCallback callback, void* user_data);
+
+  // Waits for the frame's deadline, then swaps the window's buffers
+  void present();
+
+  // Smoothed frame time in seconds, for advancing the simulation without
+  // passing the jitter of single frames on
+  inline double delta_time() const { return _smoothed_ms / 1000.0; }
+  inline uint64_t frame_count() const { return _frame; }
+
+  inline const FramePacerStats& last_frame() const {
+    return _history[(_frame + s_History - 1) % s_History];
+  }
+  // Stats of a recent frame, 0 is the last one, up to s_History - 1
+  inline const FramePacerStats& history(size_t frames_ago) const {
+    return _history[(_frame + s_History - 1 - frames_ago) % s_History];
+  }
+  // Logs frame time percentiles and missed deadlines over the history
+  void log() const;
+
+private:
+  void _wait_until(uint64_t deadline_ns, FramePacerStats& stats);
+  void _call_wait_callback();
+
+private:
+  WindowHandle* _window_ptr = nullptr;
+  FramePacerConfig _config;
+  FramePacerWaitCallback _wait_callback = nullptr;
+  void* _wait_user_data                 = nullptr;
+
+  uint64_t _period_ns       = 0;
+  uint64_t _deadline_ns     = 0;
+  uint64_t _last_present_ns = 0;
+  double _oversleep_ms      = 0.0;  // Moving average of late wake ups
+  double _smoothed_ms       = 0.0;
+  uint64_t _frame           = 0;
+  FramePacerStats _history[s_History];
+};
+
+#endif
@@ -0,0 +1,108 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef GFX_RHI_BASE_FRAME_SYNC_H
+#define GFX_RHI_BASE_FRAME_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WindowHandle;
+
+// Lets the CPU record the next frames while the GPU still works on earlier
+// ones. Every frame in flight owns a slot, a fence is inserted when the frame
+// is submitted and begin_frame only waits on the fence of the slot it is
+// about to reuse, so per frame resources are never overwritten while the GPU
+// reads them and the CPU never waits for the whole pipeline to drain.
+//
+// WindowHandle_TrippleBufferBit keeps 3 frames in flight for throughput,
+// otherwise 2 are kept for lower latency. The fences belong to the window's
+// context, destroy() has to run before WindowHandle::destroy().
+class FramesInFlight {
+public:
+  static constexpr uint32_t s_MaxFrames = 3;
+
+public:
+  FramesInFlight(WindowHandle* window);
+  ~FramesInFlight();
+
+  // Deletes the fences still in flight
+  void destroy();
+
+  inline WindowHandle* window() const { return _window_ptr; }
+  inline uint32_t count() const { return _count; }
+  // Slot of the frame being recorded, indexes per frame resources
+  inline uint32_t index() const { return (uint32_t)(_frame % _count); }
+  inline uint64_t frame() const { return _frame; }
+  // Time begin_frame spent waiting on the GPU
+  inline double last_wait_ms() const { return _last_wait_ms; }
+
+  // Waits until the GPU is done with the slot of this frame
+  void begin_frame();
+  // Fences the frame's commands, call before presenting
+  void end_frame();
+
+private:
+  WindowHandle* _window_ptr  = nullptr;
+  uint32_t _count            = 2;
+  uint64_t _frame            = 0;
+  double _last_wait_ms       = 0.0;
+  void* _fences[s_MaxFrames] = {};  // GLsync
+};
+
+// Persistently mapped buffer split into one region per frame in flight, for
+// data rewritten every frame such as dynamic vertices and uniform ranges.
+// Allocations are a bump of the current region's cursor and are valid until
+// the end of the frame, the fences of FramesInFlight keep the GPU from still
+// reading a region when it is handed out again. Like FramesInFlight it has to
+// be destroyed before the window.
+class FrameRingBuffer {
+public:
+  struct Allocation {
+    void* data    = nullptr;  // Write only, null when the region is full
+    size_t offset = 0;        // Into buffer(), for glBindBufferRange
+    size_t size   = 0;
+  };
+
+public:
+  // - frame_size: Bytes available to each frame
+  FrameRingBuffer(const FramesInFlight* frames, size_t frame_size);
+  ~FrameRingBuffer();
+
+  // Unmaps and deletes the buffer
+  void destroy();
+
+  // - alignment: Zero uses GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  Allocation allocate(size_t size, size_t alignment = 0);
+
+  inline uint32_t buffer() const { return _buffer; }
+  inline size_t frame_size() const { return _frame_size; }
+
+private:
+  const FramesInFlight* _frames = nullptr;
+  size_t _frame_size            = 0;
+  size_t _alignment             = 256;
+  uint32_t _buffer              = 0;
+  uint8_t* _mapped              = nullptr;
+
+  uint64_t _cursor_frame = UINT64_MAX;
+  size_t _cursor         = 0;
+
+  // Stands in for the mapping without a rendering context
+  std::vector<uint8_t> _fallback;
+};
+
+#endif
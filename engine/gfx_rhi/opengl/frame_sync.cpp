@@ -0,0 +1,149 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifdef RHI_USE_OPENGL
+
+#include "gfx_rhi/frame_sync.h"
+#include "core/console.h"
+#include "gfx_rhi/window_handle.h"
+#include <chrono>
+#include <glad/glad.h>
+
+// Waits are retried in steps of this, a fence that takes longer than a few
+// steps means the GPU is hung
+static constexpr GLuint64 s_FenceWaitStepNs = 100000000;
+
+FramesInFlight::FramesInFlight(WindowHandle* window) : _window_ptr(window) {
+  _count = (window->options() & WindowHandle_TrippleBufferBit) ? 3 : 2;
+}
+
+FramesInFlight::~FramesInFlight() {
+  destroy();
+}
+
+void FramesInFlight::destroy() {
+  if (!_window_ptr->has_context()) {
+    return;
+  }
+  for (void*& fence : _fences) {
+    if (fence != nullptr) {
+      glDeleteSync((GLsync)fence);
+      fence = nullptr;
+    }
+  }
+}
+
+void FramesInFlight::begin_frame() {
+  _last_wait_ms = 0.0;
+  GLsync fence  = (GLsync)_fences[index()];
+  if (fence == nullptr) {
+    return;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  // Flushing makes sure the fence is submitted, otherwise the wait could
+  // never end
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  for (int step = 0; result == GL_TIMEOUT_EXPIRED; step++) {
+    if (step == 10) {
+      RHI_WARN("Frame {} fence not signaled after {}s", _frame - _count,
+               step * s_FenceWaitStepNs / 1e9);
+    }
+    result = glClientWaitSync(fence, 0, s_FenceWaitStepNs);
+  }
+  if (result == GL_WAIT_FAILED) {
+    RHI_ERROR("Waiting on the fence of frame {} failed", _frame - _count);
+  }
+  _last_wait_ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+
+  glDeleteSync(fence);
+  _fences[index()] = nullptr;
+}
+
+void FramesInFlight::end_frame() {
+  if (_window_ptr->has_context()) {
+    _fences[index()] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  _frame++;
+}
+
+FrameRingBuffer::FrameRingBuffer(const FramesInFlight* frames,
+                                 size_t frame_size)
+    : _frames(frames), _frame_size(frame_size) {
+  size_t total = frame_size * frames->count();
+  if (glad_glNamedBufferStorage == nullptr) {
+    // No context, or one without GL 4.5
+    _fallback.resize(total);
+    _mapped = _fallback.data();
+    return;
+  }
+
+  GLint alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  _alignment = alignment > 0 ? (size_t)alignment : _alignment;
+
+  // Coherent so writes need no explicit flush before the draw reading them
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &_buffer);
+  glNamedBufferStorage(_buffer, (GLsizeiptr)total, nullptr, flags);
+  _mapped =
+      (uint8_t*)glMapNamedBufferRange(_buffer, 0, (GLsizeiptr)total, flags);
+  if (_mapped == nullptr) {
+    RHI_ERROR("Failed to map frame ring buffer");
+  }
+}
+
+FrameRingBuffer::~FrameRingBuffer() {
+  destroy();
+}
+
+void FrameRingBuffer::destroy() {
+  if (_buffer != 0 && _frames->window()->has_context()) {
+    glUnmapNamedBuffer(_buffer);
+    glDeleteBuffers(1, &_buffer);
+  }
+  _buffer = 0;
+  _mapped = nullptr;
+  _fallback.clear();
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::allocate(size_t size,
+                                                      size_t alignment) {
+  if (_cursor_frame != _frames->frame()) {
+    _cursor_frame = _frames->frame();
+    _cursor       = 0;
+  }
+
+  alignment     = alignment == 0 ? _alignment : alignment;
+  size_t offset = (_cursor + alignment - 1) / alignment * alignment;
+  if (_mapped == nullptr || offset + size > _frame_size) {
+    CONTEXT_ERROR_ONCE("OPENGL",
+                       "Frame ring buffer of {} bytes per frame is full",
+                       _frame_size);
+    return Allocation();
+  }
+  _cursor = offset + size;
+
+  Allocation allocation;
+  allocation.offset = _frames->index() * _frame_size + offset;
+  allocation.data   = _mapped + allocation.offset;
+  allocation.size   = size;
+  return allocation;
+}
+
+#endif
@@ -0,0 +1,476 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifdef RHI_USE_OPENGL
+
+#include "gfx_rhi/shader.h"
+#include "core/console.h"
+#include "core/cstr_utils.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <glad/glad.h>
+#include <mutex>
+#include <thread>
+
+struct ShaderBinaryHeader {
+  static constexpr uint32_t s_Magic   = 0x42535746;  // "FWSB"
+  static constexpr uint32_t s_Version = 1;
+
+  uint32_t magic       = s_Magic;
+  uint32_t version     = s_Version;
+  uint32_t format      = 0;  // GLenum from glGetProgramBinary
+  uint32_t size        = 0;
+  uint64_t driver_hash = 0;
+  uint64_t source_hash = 0;
+};
+
+// Writes binaries on its own thread, so a program finishing in poll() never
+// waits on the disk
+struct ShaderBinaryWriter {
+  struct Write {
+    std::string path;
+    std::vector<uint8_t> data;  // ShaderBinaryHeader followed by the binary
+  };
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Write> writes;
+  bool stop = false;
+  std::thread thread;
+};
+
+static void _write_binary(const ShaderBinaryWriter::Write& write) {
+  std::string temp = write.path + ".tmp";
+  FILE* file       = std::fopen(temp.c_str(), "wb");
+  if (file == nullptr) {
+    RHI_WARN("Cannot write shader binary '{}'", temp);
+    return;
+  }
+  bool written = std::fwrite(write.data.data(), 1, write.data.size(), file) ==
+                 write.data.size();
+  written &= std::fclose(file) == 0;
+
+  std::error_code error;
+  if (written) {
+    std::filesystem::rename(temp, write.path, error);
+  }
+  if (!written || error) {
+    RHI_WARN("Cannot write shader binary '{}'", write.path);
+    std::filesystem::remove(temp, error);
+  }
+}
+
+// Runs until stop is set and every queued write is done
+static void _binary_writer(ShaderBinaryWriter* writer) {
+  std::vector<ShaderBinaryWriter::Write> writes;
+  std::unique_lock<std::mutex> lock(writer->mutex);
+  while (true) {
+    writer->wake.wait(lock, [writer] {
+      return writer->stop || !writer->writes.empty();
+    });
+    if (writer->writes.empty()) {
+      return;
+    }
+    writes.swap(writer->writes);
+    lock.unlock();
+    for (const ShaderBinaryWriter::Write& write : writes) {
+      _write_binary(write);
+    }
+    writes.clear();
+    lock.lock();
+  }
+}
+
+static GLenum _gl_stage(ShaderStage stage) {
+  switch (stage) {
+  case ShaderStage_Vertex:
+    return GL_VERTEX_SHADER;
+  case ShaderStage_TessControl:
+    return GL_TESS_CONTROL_SHADER;
+  case ShaderStage_TessEvaluation:
+    return GL_TESS_EVALUATION_SHADER;
+  case ShaderStage_Geometry:
+    return GL_GEOMETRY_SHADER;
+  case ShaderStage_Fragment:
+    return GL_FRAGMENT_SHADER;
+  case ShaderStage_Compute:
+    return GL_COMPUTE_SHADER;
+  default:
+    return GL_NONE;
+  }
+}
+
+static std::string _shader_log(GLuint shader) {
+  GLint length = 0;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+  std::string log((size_t)std::max(length, 1), '\0');
+  glGetShaderInfoLog(shader, length, nullptr, log.data());
+  log.resize(std::char_traits<char>::length(log.c_str()));
+  return log;
+}
+
+static std::string _program_log(GLuint program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+  std::string log((size_t)std::max(length, 1), '\0');
+  glGetProgramInfoLog(program, length, nullptr, log.data());
+  log.resize(std::char_traits<char>::length(log.c_str()));
+  return log;
+}
+
+void ShaderProgram::bind() const {
+  glUseProgram(_handle);
+}
+
+void ShaderProgram::destroy() {
+  if (_handle != 0) {
+    glDeleteProgram(_handle);
+    _handle     = 0;
+    _reflection = ShaderReflection();
+  }
+}
+
+ShaderCache::ShaderCache(const std::string_view& directory)
+    : _directory(directory) {
+  if (glad_glGetProgramBinary == nullptr) {
+    return;
+  }
+
+  // Zero threads would turn the extension off, all ones lets the driver pick
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+    _parallel_compile = true;
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xffffffff);
+    _parallel_compile = true;
+  }
+
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  _binaries_supported = formats > 0 && !_directory.empty();
+  if (!_binaries_supported) {
+    return;
+  }
+
+  // A driver update changes the version string, invalidating every binary
+  uint64_t hash = shader_hash(nullptr, 0);
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const char* str = (const char*)glGetString(name);
+    hash            = shader_hash(str, fiwre::cstr_length(str), hash);
+  }
+  _driver_hash = hash;
+
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+  if (error) {
+    RHI_WARN("Cannot create shader cache directory '{}': {}", _directory,
+             error.message());
+    _binaries_supported = false;
+    return;
+  }
+  _writer         = std::make_unique<ShaderBinaryWriter>();
+  _writer->thread = std::thread(_binary_writer, _writer.get());
+}
+
+ShaderCache::~ShaderCache() {
+  for (Entry& entry : _entries) {
+    _cancel_job(entry.job);
+  }
+  if (_writer != nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(_writer->mutex);
+      _writer->stop = true;
+    }
+    _writer->wake.notify_one();
+    _writer->thread.join();
+  }
+}
+
+bool ShaderCache::build(ShaderProgram& program,
+                        const std::vector<ShaderStageSource>& stages) {
+  RHI_CONDITION_ERROR_RETURN(glad_glCreateProgram != nullptr, false,
+                             "Cannot build shaders without a context");
+
+  ShaderProgram built;
+  built._source_hash = shader_hash(stages);
+  if (_binaries_supported && _load_binary(built, built._source_hash)) {
+    _stats.hits++;
+    program = std::move(built);
+    return true;
+  }
+
+  Job job       = _start_job(stages, _binaries_supported);
+  built._handle = _finish_job(job);
+  if (built._handle == 0) {
+    _stats.failed++;
+    return false;
+  }
+  built._reflection = ShaderReflection::reflect(built._handle);
+  if (_binaries_supported) {
+    _store_binary(built);
+  }
+  program = std::move(built);
+  return true;
+}
+
+ShaderHandle
+    ShaderCache::submit(const std::vector<ShaderStageSource>& stages) {
+  ShaderHandle handle = (ShaderHandle)_entries.size();
+  Entry& entry        = _entries.emplace_back();
+  if (glad_glCreateProgram == nullptr) {
+    RHI_ERROR("Cannot build shaders without a context");
+    entry.status = ShaderStatus_Failed;
+    return handle;
+  }
+  _start(entry, stages);
+  return handle;
+}
+
+bool ShaderCache::rebuild(ShaderHandle handle,
+                          const std::vector<ShaderStageSource>& stages) {
+  RHI_CONDITION_ERROR_RETURN(handle < _entries.size(), false,
+                             "Invalid shader handle {}", handle);
+  RHI_CONDITION_ERROR_RETURN(glad_glCreateProgram != nullptr, false,
+                             "Cannot build shaders without a context");
+
+  Entry& entry = _entries[handle];
+  if (entry.job.program != 0) {
+    _cancel_job(entry.job);
+    _pending--;
+  }
+  _start(entry, stages);
+  return true;
+}
+
+void ShaderCache::poll() {
+  if (_pending == 0) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::milli> budget(_poll_budget_ms);
+  for (Entry& entry : _entries) {
+    if (entry.job.program == 0 || !_job_completed(entry.job)) {
+      continue;
+    }
+    _complete(entry);
+    if (_pending == 0 || (!_parallel_compile &&
+                          std::chrono::steady_clock::now() - start > budget)) {
+      break;
+    }
+  }
+}
+
+void ShaderCache::_complete(Entry& entry) {
+  ShaderProgram built;
+  built._source_hash = entry.job.source_hash;
+  built._handle      = _finish_job(entry.job);
+  _pending--;
+  if (built._handle == 0) {
+    // A rebuild that fails keeps the program it was meant to replace
+    _stats.failed++;
+    if (!entry.program.valid()) {
+      entry.status = ShaderStatus_Failed;
+    }
+    return;
+  }
+  built._reflection = ShaderReflection::reflect(built._handle);
+  if (_binaries_supported) {
+    _store_binary(built);
+  }
+  entry.program = std::move(built);
+  entry.status  = ShaderStatus_Ready;
+  entry.generation++;
+}
+
+void ShaderCache::_start(Entry& entry,
+                         const std::vector<ShaderStageSource>& stages) {
+  uint64_t source_hash = shader_hash(stages);
+  if (entry.program.valid() && entry.program._source_hash == source_hash) {
+    return;
+  }
+
+  ShaderProgram cached;
+  if (_binaries_supported && _load_binary(cached, source_hash)) {
+    _stats.hits++;
+    cached._source_hash = source_hash;
+    entry.program       = std::move(cached);
+    entry.status        = ShaderStatus_Ready;
+    entry.generation++;
+    return;
+  }
+  entry.job             = _start_job(stages, _binaries_supported);
+  entry.job.source_hash = source_hash;
+  _pending++;
+}
+
+bool ShaderCache::_load_binary(ShaderProgram& program, uint64_t source_hash) {
+  std::string path = _binary_path(source_hash);
+  FILE* file       = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    _stats.misses++;
+    return false;
+  }
+
+  ShaderBinaryHeader header;
+  std::vector<uint8_t> binary;
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+               header.magic == ShaderBinaryHeader::s_Magic &&
+               header.version == ShaderBinaryHeader::s_Version &&
+               header.driver_hash == _driver_hash &&
+               header.source_hash == source_hash;
+  // The size comes from the file, only trust it once the file is that long
+  // so a damaged header cannot ask for a huge allocation
+  std::error_code error;
+  uintmax_t file_size = std::filesystem::file_size(path, error);
+  valid = valid && !error && file_size == sizeof(header) + header.size;
+  if (valid) {
+    binary.resize(header.size);
+    valid = std::fread(binary.data(), 1, binary.size(), file) == header.size;
+  }
+  std::fclose(file);
+  if (!valid) {
+    // Written by another driver or damaged, rebuilt and replaced
+    _stats.misses++;
+    return false;
+  }
+
+  GLuint handle = glCreateProgram();
+  glProgramBinary(handle, (GLenum)header.format, binary.data(),
+                  (GLsizei)binary.size());
+  GLint linked = GL_FALSE;
+  glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    RHI_VERBOSE("Driver rejected cached shader binary '{}'", path);
+    glDeleteProgram(handle);
+    _stats.rejected++;
+    return false;
+  }
+  program._handle     = handle;
+  program._reflection = ShaderReflection::reflect(handle);
+  return true;
+}
+
+void ShaderCache::_store_binary(const ShaderProgram& program) {
+  GLint size = 0;
+  glGetProgramiv(program._handle, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+
+  ShaderBinaryWriter::Write write;
+  write.path = _binary_path(program._source_hash);
+  write.data.resize(sizeof(ShaderBinaryHeader) + (size_t)size);
+  GLenum format = GL_NONE;
+  glGetProgramBinary(program._handle, size, &size, &format,
+                     write.data.data() + sizeof(ShaderBinaryHeader));
+  write.data.resize(sizeof(ShaderBinaryHeader) + (size_t)size);
+
+  ShaderBinaryHeader header;
+  header.format      = format;
+  header.size        = (uint32_t)size;
+  header.driver_hash = _driver_hash;
+  header.source_hash = program._source_hash;
+  std::memcpy(write.data.data(), &header, sizeof(header));
+
+  {
+    std::lock_guard<std::mutex> lock(_writer->mutex);
+    _writer->writes.push_back(std::move(write));
+  }
+  _writer->wake.notify_one();
+}
+
+ShaderCache::Job
+    ShaderCache::_start_job(const std::vector<ShaderStageSource>& stages,
+                            bool retrievable) {
+  Job job;
+  job.program = glCreateProgram();
+  for (const ShaderStageSource& stage : stages) {
+    GLuint shader      = glCreateShader(_gl_stage(stage.stage));
+    const char* source = stage.source.c_str();
+    GLint length       = (GLint)stage.source.size();
+    glShaderSource(shader, 1, &source, &length);
+    glCompileShader(shader);
+    glAttachShader(job.program, shader);
+    job.stages.push_back({shader, stage.stage, stage.path, stage.files});
+  }
+
+  // Linking straight away without checking the compile status keeps the
+  // driver busy, a failed stage also fails the link and is reported then
+  if (retrievable) {
+    glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
+  glLinkProgram(job.program);
+  return job;
+}
+
+void ShaderCache::_cancel_job(Job& job) {
+  for (const Job::Stage& stage : job.stages) {
+    glDeleteShader(stage.shader);
+  }
+  if (job.program != 0) {
+    glDeleteProgram(job.program);
+  }
+  job = Job();
+}
+
+bool ShaderCache::_job_completed(const Job& job) const {
+  if (!_parallel_compile) {
+    return true;
+  }
+  GLint completed = GL_FALSE;
+  glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+  return completed;
+}
+
+uint32_t ShaderCache::_finish_job(Job& job) {
+  GLuint program = job.program;
+  GLint linked   = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+  bool compiled = true;
+  for (const Job::Stage& stage : job.stages) {
+    GLint status = GL_TRUE;
+    if (!linked) {
+      glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &status);
+    }
+    if (!status) {
+      RHI_ERROR("Failed to compile {} shader '{}':\n{}",
+                shader_stage_to_string(stage.stage), stage.path,
+                shader_map_log(_shader_log(stage.shader), stage.files));
+      compiled = false;
+    }
+    glDetachShader(program, stage.shader);
+    glDeleteShader(stage.shader);
+  }
+  if (!linked && compiled) {
+    RHI_ERROR("Failed to link shader program ({}):\n{}",
+              job.stages.empty() ? std::string_view() : job.stages[0].path,
+              _program_log(program));
+  }
+
+  job = Job();
+  if (!linked) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+#endif
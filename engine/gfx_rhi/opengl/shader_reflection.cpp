@@ -0,0 +1,272 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifdef RHI_USE_OPENGL
+
+#include "gfx_rhi/shader_reflection.h"
+#include "gfx_rhi/frame_sync.h"
+#include "gfx_rhi/shader.h"
+#include <algorithm>
+#include <glad/glad.h>
+
+static ShaderDataType _data_type(GLenum type) {
+  switch (type) {
+  case GL_FLOAT:
+    return ShaderDataType_Float;
+  case GL_FLOAT_VEC2:
+    return ShaderDataType_Vec2;
+  case GL_FLOAT_VEC3:
+    return ShaderDataType_Vec3;
+  case GL_FLOAT_VEC4:
+    return ShaderDataType_Vec4;
+  case GL_INT:
+    return ShaderDataType_Int;
+  case GL_INT_VEC2:
+    return ShaderDataType_IVec2;
+  case GL_INT_VEC3:
+    return ShaderDataType_IVec3;
+  case GL_INT_VEC4:
+    return ShaderDataType_IVec4;
+  case GL_UNSIGNED_INT:
+    return ShaderDataType_UInt;
+  case GL_UNSIGNED_INT_VEC2:
+    return ShaderDataType_UVec2;
+  case GL_UNSIGNED_INT_VEC3:
+    return ShaderDataType_UVec3;
+  case GL_UNSIGNED_INT_VEC4:
+    return ShaderDataType_UVec4;
+  case GL_BOOL:
+    return ShaderDataType_Bool;
+  case GL_FLOAT_MAT2:
+    return ShaderDataType_Mat2;
+  case GL_FLOAT_MAT3:
+    return ShaderDataType_Mat3;
+  case GL_FLOAT_MAT4:
+    return ShaderDataType_Mat4;
+  case GL_SAMPLER_1D:
+  case GL_SAMPLER_2D:
+  case GL_SAMPLER_3D:
+  case GL_SAMPLER_CUBE:
+  case GL_SAMPLER_2D_SHADOW:
+  case GL_SAMPLER_2D_ARRAY:
+  case GL_SAMPLER_2D_ARRAY_SHADOW:
+  case GL_SAMPLER_CUBE_SHADOW:
+  case GL_SAMPLER_CUBE_MAP_ARRAY:
+  case GL_SAMPLER_2D_MULTISAMPLE:
+  case GL_SAMPLER_BUFFER:
+  case GL_INT_SAMPLER_2D:
+  case GL_INT_SAMPLER_3D:
+  case GL_UNSIGNED_INT_SAMPLER_2D:
+  case GL_UNSIGNED_INT_SAMPLER_3D:
+  case GL_IMAGE_2D:
+  case GL_IMAGE_3D:
+  case GL_IMAGE_CUBE:
+  case GL_IMAGE_2D_ARRAY:
+  case GL_INT_IMAGE_2D:
+  case GL_UNSIGNED_INT_IMAGE_2D:
+    return ShaderDataType_Sampler;
+  default:
+    return ShaderDataType_Other;
+  }
+}
+
+static std::string _resource_name(GLuint program, GLenum interface,
+                                  GLuint index, GLint length) {
+  std::string name((size_t)std::max(length, 1), '\0');
+  glGetProgramResourceName(program, interface, index, length, nullptr,
+                           name.data());
+  name.resize(std::char_traits<char>::length(name.c_str()));
+  return name;
+}
+
+static void _reflect_blocks(GLuint program, GLenum interface,
+                            ShaderBlockKind kind,
+                            std::vector<ShaderBlock>& blocks) {
+  GLint count = 0;
+  glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &count);
+  const GLenum props[] = {GL_NAME_LENGTH, GL_BUFFER_BINDING,
+                          GL_BUFFER_DATA_SIZE};
+  for (GLint i = 0; i < count; i++) {
+    GLint values[3] = {};
+    glGetProgramResourceiv(program, interface, (GLuint)i, 3, props, 3,
+                           nullptr, values);
+    ShaderBlock& block = blocks.emplace_back();
+    block.name         = _resource_name(program, interface, i, values[0]);
+    block.kind         = kind;
+    block.binding      = (uint32_t)values[1];
+    block.size         = (uint32_t)values[2];
+  }
+}
+
+ShaderReflection ShaderReflection::reflect(uint32_t program) {
+  ShaderReflection reflection;
+  if (program == 0 || glad_glGetProgramInterfaceiv == nullptr) {
+    return reflection;
+  }
+
+  // Block indices are per interface, storage blocks follow the uniform ones
+  _reflect_blocks(program, GL_UNIFORM_BLOCK, ShaderBlockKind_Uniform,
+                  reflection.blocks);
+  const size_t storage_begin = reflection.blocks.size();
+  _reflect_blocks(program, GL_SHADER_STORAGE_BLOCK, ShaderBlockKind_Storage,
+                  reflection.blocks);
+
+  GLint count = 0;
+  glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+  const GLenum uniform_props[] = {
+      GL_NAME_LENGTH, GL_TYPE,   GL_LOCATION,     GL_ARRAY_SIZE,
+      GL_BLOCK_INDEX, GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE};
+  for (GLint i = 0; i < count; i++) {
+    GLint values[8] = {};
+    glGetProgramResourceiv(program, GL_UNIFORM, (GLuint)i, 8, uniform_props,
+                           8, nullptr, values);
+    ShaderVariable variable;
+    variable.name       = _resource_name(program, GL_UNIFORM, i, values[0]);
+    variable.type       = _data_type((GLenum)values[1]);
+    variable.location   = values[2];
+    variable.array_size = (uint32_t)std::max(values[3], 1);
+    if (values[4] == -1 || (size_t)values[4] >= storage_begin) {
+      reflection.uniforms.push_back(std::move(variable));
+      continue;
+    }
+    variable.offset        = (uint32_t)values[5];
+    variable.array_stride  = (uint32_t)values[6];
+    variable.matrix_stride = (uint32_t)values[7];
+    reflection.blocks[values[4]].members.push_back(std::move(variable));
+  }
+
+  glGetProgramInterfaceiv(program, GL_BUFFER_VARIABLE, GL_ACTIVE_RESOURCES,
+                          &count);
+  const GLenum buffer_props[] = {
+      GL_NAME_LENGTH,   GL_TYPE,
+      GL_ARRAY_SIZE,    GL_BLOCK_INDEX,
+      GL_OFFSET,        GL_ARRAY_STRIDE,
+      GL_MATRIX_STRIDE, GL_TOP_LEVEL_ARRAY_SIZE,
+      GL_TOP_LEVEL_ARRAY_STRIDE};
+  for (GLint i = 0; i < count; i++) {
+    GLint values[9] = {};
+    glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, (GLuint)i, 9,
+                           buffer_props, 9, nullptr, values);
+    size_t block = storage_begin + (size_t)values[3];
+    if (values[3] < 0 || block >= reflection.blocks.size()) {
+      continue;
+    }
+    ShaderVariable variable;
+    variable.name =
+        _resource_name(program, GL_BUFFER_VARIABLE, i, values[0]);
+    variable.type          = _data_type((GLenum)values[1]);
+    variable.array_size    = (uint32_t)std::max(values[2], 1);
+    variable.offset        = (uint32_t)values[4];
+    variable.array_stride  = (uint32_t)values[5];
+    variable.matrix_stride = (uint32_t)values[6];
+    // Members of an array of structs are only listed for the first element,
+    // the field index then steps over the whole struct
+    if (variable.array_stride == 0 && values[8] > 0) {
+      variable.array_size   = (uint32_t)std::max(values[7], 1);
+      variable.array_stride = (uint32_t)values[8];
+    }
+    reflection.blocks[block].members.push_back(std::move(variable));
+  }
+  return reflection;
+}
+
+template <typename T>
+void ShaderUniform<T>::set(const T* values, uint32_t count) {
+  if (_cache != nullptr) {
+    shader_refresh_uniform(*_cache, _entry, _name, ShaderDataTypeOf<T>::type,
+                           _generation, _program, _location, _count);
+  }
+  if (_location == -1) {
+    return;
+  }
+  const GLsizei size = (GLsizei)std::min(count, _count);
+  const GLuint p     = _program;
+  const GLint l      = _location;
+
+  constexpr ShaderDataType type = ShaderDataTypeOf<T>::type;
+  if constexpr (type == ShaderDataType_Float) {
+    glProgramUniform1fv(p, l, size, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Vec2) {
+    glProgramUniform2fv(p, l, size, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Vec3) {
+    glProgramUniform3fv(p, l, size, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Vec4) {
+    glProgramUniform4fv(p, l, size, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Int) {
+    glProgramUniform1iv(p, l, size, (const GLint*)values);
+  } else if constexpr (type == ShaderDataType_IVec2) {
+    glProgramUniform2iv(p, l, size, (const GLint*)values);
+  } else if constexpr (type == ShaderDataType_IVec3) {
+    glProgramUniform3iv(p, l, size, (const GLint*)values);
+  } else if constexpr (type == ShaderDataType_IVec4) {
+    glProgramUniform4iv(p, l, size, (const GLint*)values);
+  } else if constexpr (type == ShaderDataType_UInt) {
+    glProgramUniform1uiv(p, l, size, (const GLuint*)values);
+  } else if constexpr (type == ShaderDataType_UVec2) {
+    glProgramUniform2uiv(p, l, size, (const GLuint*)values);
+  } else if constexpr (type == ShaderDataType_UVec3) {
+    glProgramUniform3uiv(p, l, size, (const GLuint*)values);
+  } else if constexpr (type == ShaderDataType_UVec4) {
+    glProgramUniform4uiv(p, l, size, (const GLuint*)values);
+  } else if constexpr (type == ShaderDataType_Mat2) {
+    glProgramUniformMatrix2fv(p, l, size, GL_FALSE, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Mat3) {
+    glProgramUniformMatrix3fv(p, l, size, GL_FALSE, (const GLfloat*)values);
+  } else if constexpr (type == ShaderDataType_Mat4) {
+    glProgramUniformMatrix4fv(p, l, size, GL_FALSE, (const GLfloat*)values);
+  }
+}
+
+template class ShaderUniform<float>;
+template class ShaderUniform<glm::vec2>;
+template class ShaderUniform<glm::vec3>;
+template class ShaderUniform<glm::vec4>;
+template class ShaderUniform<int32_t>;
+template class ShaderUniform<glm::ivec2>;
+template class ShaderUniform<glm::ivec3>;
+template class ShaderUniform<glm::ivec4>;
+template class ShaderUniform<uint32_t>;
+template class ShaderUniform<glm::uvec2>;
+template class ShaderUniform<glm::uvec3>;
+template class ShaderUniform<glm::uvec4>;
+template class ShaderUniform<glm::mat2>;
+template class ShaderUniform<glm::mat3>;
+template class ShaderUniform<glm::mat4>;
+
+bool ShaderBlockData::upload(FrameRingBuffer& ring) const {
+  size_t alignment = 0;
+  GLenum target    = GL_UNIFORM_BUFFER;
+  if (_block.kind == ShaderBlockKind_Storage) {
+    static GLint storage_alignment = 0;
+    if (storage_alignment == 0) {
+      glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+                    &storage_alignment);
+    }
+    alignment = (size_t)std::max(storage_alignment, 1);
+    target    = GL_SHADER_STORAGE_BUFFER;
+  }
+
+  FrameRingBuffer::Allocation allocation = ring.allocate(_data.size(),
+                                                         alignment);
+  if (allocation.data == nullptr) {
+    return false;
+  }
+  std::memcpy(allocation.data, _data.data(), _data.size());
+  glBindBufferRange(target, _block.binding, ring.buffer(),
+                    (GLintptr)allocation.offset, (GLsizeiptr)allocation.size);
+  return true;
+}
+
+#endif
@@ -17,6 +17,7 @@
 #define GLFW_INCLUDE_NONE
 #include "gfx_rhi/window_handle.h"
 #include "core/console.h"
+#include "core/input_events.h"
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 
@@ -51,9 +52,21 @@ bool WindowHandle::_initialize(const std::string_view& title, int32_t width,
     monitor = nullptr;
   }
 
-  GLFWwindow* window =
-      glfwCreateWindow(width, height, title.data(), monitor, nullptr);
+  GLFWwindow* window = nullptr;
+  if (flags & WindowHandle_HeadlessBit) {
+    window = _create_headless_window(width, height, title.data());
+  } else {
+    window = glfwCreateWindow(width, height, title.data(), monitor, nullptr);
+  }
   RHI_CONDITION_FATAL(window != nullptr, "Failed to create GLFW window");
+  _win_ptr     = window;
+  _opts        = flags;
+  _has_context = glfwGetWindowAttrib(window, GLFW_CLIENT_API) != GLFW_NO_API;
+  if (!_has_context) {
+    RHI_WARN("No OpenGL context available for the headless window, frames "
+             "will not be rendered");
+    return false;
+  }
   glfwMakeContextCurrent(window);
 
   if (!s_GladInitialized) {
@@ -62,19 +75,62 @@ bool WindowHandle::_initialize(const std::string_view& title, int32_t width,
                         "Failed to initialize GLAD");
   }
 
-  if (flags & WindowHandle_VsyncBit) {
-    glfwSwapInterval(0);
-  } else {
-    glfwSwapInterval(1);
+  set_vsync(flags & WindowHandle_VsyncBit,
+            flags & WindowHandle_AdaptiveVsyncBit);
+  return false;
+}
+
+void WindowHandle::set_vsync(bool enabled, bool adaptive) {
+  _opts &= ~(WindowHandle_VsyncBit | WindowHandle_AdaptiveVsyncBit);
+  _opts |= (enabled ? WindowHandle_VsyncBit : 0) |
+           (adaptive ? WindowHandle_AdaptiveVsyncBit : 0);
+  if (!_has_context) {
+    return;
   }
 
-  _win_ptr = window;
-  _opts    = flags;
-  return false;
+  int interval = enabled ? 1 : 0;
+  if (enabled && adaptive) {
+    bool tear = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    if (!tear) {
+      RHI_WARN("Adaptive vsync is not supported, using vsync");
+    }
+    interval = tear ? -1 : 1;
+  }
+  glfwSwapInterval(interval);
+}
+
+GLFWwindow* WindowHandle::_create_headless_window(int32_t width,
+                                                  int32_t height,
+                                                  const char* title) {
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+  // Failing to find a software context is expected on machines without one,
+  // keep those errors out of the log
+  GLFWerrorfun error_callback = glfwSetErrorCallback(nullptr);
+  const int context_apis[] = {GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API};
+  GLFWwindow* window       = nullptr;
+  for (int api : context_apis) {
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+    window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    if (window != nullptr) {
+      break;
+    }
+  }
+  if (window == nullptr) {
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+  }
+  glfwSetErrorCallback(error_callback);
+  glfwDefaultWindowHints();
+  return window;
 }
 
 void WindowHandle::swap_buffers() {
-  glfwSwapBuffers(_win_ptr);
+  _last_swap_ns = input_time_ns();
+  if (_has_context) {
+    glfwSwapBuffers(_win_ptr);
+  }
 }
 
 #endif
@@ -0,0 +1,234 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef GFX_RHI_BASE_SHADER_H
+#define GFX_RHI_BASE_SHADER_H
+
+#include "gfx_rhi/shader_reflection.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum ShaderStage {
+  ShaderStage_Vertex,
+  ShaderStage_TessControl,
+  ShaderStage_TessEvaluation,
+  ShaderStage_Geometry,
+  ShaderStage_Fragment,
+  ShaderStage_Compute,
+  ShaderStage_Count,
+};
+
+struct ShaderStageSource {
+  ShaderStage stage = ShaderStage_Vertex;
+  std::string source;
+  // File the source came from, only used in error messages
+  std::string path;
+  // Files by the source string number of #line directives, names them in
+  // compile errors, see shader_load_source()
+  std::vector<std::string> files;
+};
+
+// Reads a GLSL file, expanding #include "file" relative to the including
+// file. A file is only included once per stage, every file read is listed
+// in stage.files and its lines are marked with #line, so errors name the
+// file and line they are in. Returns false when a file cannot be read
+bool shader_load_source(const std::string_view& path, ShaderStage stage,
+                        ShaderStageSource& result);
+
+// Replaces the source string numbers at the start of driver log lines with
+// file names, e.g. "1:12(4): error" becomes "common.glsl:12(4): error"
+std::string shader_map_log(const std::string_view& log,
+                           const std::vector<std::string>& files);
+
+// 64 bit FNV-1a, seed chains hashes of several buffers
+uint64_t shader_hash(const void* data, size_t size,
+                     uint64_t seed = 0xcbf29ce484222325);
+uint64_t shader_hash(const std::vector<ShaderStageSource>& stages);
+
+std::string_view shader_stage_to_string(ShaderStage stage);
+
+// Linked program, move only
+class ShaderProgram {
+public:
+  ShaderProgram() = default;
+  ShaderProgram(ShaderProgram&& other);
+  ShaderProgram& operator=(ShaderProgram&& other);
+  ShaderProgram(const ShaderProgram&)            = delete;
+  ShaderProgram& operator=(const ShaderProgram&) = delete;
+  ~ShaderProgram();
+
+  inline bool valid() const { return _handle != 0; }
+  inline uint32_t handle() const { return _handle; }
+  // shader_hash of the sources it was built from
+  inline uint64_t source_hash() const { return _source_hash; }
+  // Uniforms and blocks, gathered when the program is built
+  inline const ShaderReflection& reflection() const { return _reflection; }
+
+  void bind() const;
+  void destroy();
+
+private:
+  friend class ShaderCache;
+
+  uint32_t _handle      = 0;
+  uint64_t _source_hash = 0;
+  ShaderReflection _reflection;
+};
+
+enum ShaderStatus {
+  ShaderStatus_Pending,  // Still compiling, nothing to draw with yet
+  ShaderStatus_Ready,
+  ShaderStatus_Failed,
+};
+
+// Index of a program owned by ShaderCache, stays valid for the cache's life
+using ShaderHandle = uint32_t;
+
+// Builds programs, keeping every linked program's binary on disk.
+//
+// A binary is stored as <directory>/<source hash>.bin and is only used when
+// it was written by the same driver (vendor, renderer and version string),
+// anything stale, corrupt or rejected by the driver is rebuilt from source
+// and overwritten. Only reading the binary back from the driver happens on
+// the calling thread, files are written by a thread of the cache's own, to a
+// temporary name that is then renamed so a crash never leaves a half written
+// binary behind. Writes still queued are finished when the cache is deleted.
+//
+// submit() only hands the sources to the driver and returns, poll() picks up
+// the programs that finished. With GL_KHR_parallel_shader_compile the driver
+// compiles on its own threads and poll() never blocks, otherwise poll()
+// finishes as many programs as fit its time budget so a burst of new
+// programs is spread over several frames instead of stalling one.
+struct ShaderBinaryWriter;
+
+class ShaderCache {
+public:
+  static constexpr ShaderHandle s_InvalidHandle = UINT32_MAX;
+
+  struct Stats {
+    uint32_t hits     = 0;  // Loaded from a binary
+    uint32_t misses   = 0;  // No binary for the sources and driver
+    uint32_t rejected = 0;  // The driver refused a matching binary
+    uint32_t failed   = 0;  // Compile or link errors
+  };
+
+public:
+  // - directory: Created when missing, an empty path disables the disk cache
+  ShaderCache(const std::string_view& directory);
+  ~ShaderCache();
+
+  // Loads the cached binary for the sources or compiles and links them,
+  // returns false and leaves program untouched on errors. Blocks until the
+  // driver is done, prefer submit() for anything loaded while rendering
+  bool build(ShaderProgram& program,
+             const std::vector<ShaderStageSource>& stages);
+
+  // Starts building a program without waiting on the driver, submit every
+  // program that is known up front before the first poll()
+  ShaderHandle submit(const std::vector<ShaderStageSource>& stages);
+  // Builds new sources for a program in the background, the current program
+  // keeps being bound until poll() swaps in the new one, and stays when the
+  // new sources fail to build
+  bool rebuild(ShaderHandle handle,
+               const std::vector<ShaderStageSource>& stages);
+  // Collects finished programs, call once per frame
+  void poll();
+
+  ShaderStatus status(ShaderHandle handle) const;
+  // Null while the program is pending or failed. The pointer stays valid
+  // while more programs are submitted, a rebuild replaces what it points to
+  const ShaderProgram* program(ShaderHandle handle) const;
+  // Changes every time a finished build replaces the program, anything
+  // resolved against the old program (uniform locations, block layouts) has
+  // to be resolved again. ShaderUniform does so on its own
+  uint32_t generation(ShaderHandle handle) const;
+  // Binds the program or the fallback when it is not ready, returns false
+  // when neither can be bound and the draw has to be skipped
+  bool bind(ShaderHandle handle) const;
+
+  // Stands in for programs that are not ready, usually a flat debug color
+  inline void set_fallback(ShaderHandle handle) { _fallback = handle; }
+  // - budget_ms: Time poll() may block for without the parallel extension
+  inline void set_poll_budget(double budget_ms) { _poll_budget_ms = budget_ms; }
+
+  inline size_t pending() const { return _pending; }
+  inline const Stats& stats() const { return _stats; }
+  inline bool binaries_supported() const { return _binaries_supported; }
+  inline bool parallel_compile() const { return _parallel_compile; }
+
+private:
+  // Shaders handed to the driver and the program they get linked into
+  struct Job {
+    struct Stage {
+      uint32_t shader = 0;
+      ShaderStage stage = ShaderStage_Vertex;
+      std::string path;
+      std::vector<std::string> files;
+    };
+
+    uint32_t program     = 0;
+    uint64_t source_hash = 0;
+    std::vector<Stage> stages;
+  };
+
+  struct Entry {
+    ShaderProgram program;
+    ShaderStatus status = ShaderStatus_Pending;
+    uint32_t generation = 0;
+    Job job;  // In flight while job.program != 0
+  };
+
+private:
+  std::string _binary_path(uint64_t source_hash) const;
+  bool _load_binary(ShaderProgram& program, uint64_t source_hash);
+  // Reads the binary from the driver and queues it for the writer thread
+  void _store_binary(const ShaderProgram& program);
+
+  // Loads the binary or starts a job, nothing is done for sources the entry
+  // was already built from
+  void _start(Entry& entry, const std::vector<ShaderStageSource>& stages);
+  // Issues the compile and link commands without querying any status
+  static Job _start_job(const std::vector<ShaderStageSource>& stages,
+                        bool retrievable);
+  // Whether the driver finished the job, always true without the parallel
+  // extension as the status queries below block instead
+  bool _job_completed(const Job& job) const;
+  // Returns the linked program, or 0 after logging the compile and link
+  // errors, and releases the job's shaders
+  static uint32_t _finish_job(Job& job);
+  static void _cancel_job(Job& job);
+  void _complete(Entry& entry);
+
+private:
+  std::string _directory;
+  uint64_t _driver_hash    = 0;
+  bool _binaries_supported = false;
+  bool _parallel_compile   = false;
+  Stats _stats;
+  std::unique_ptr<ShaderBinaryWriter> _writer;
+
+  // Never moved, submit() may run while programs are held for drawing
+  std::deque<Entry> _entries;
+  ShaderHandle _fallback = s_InvalidHandle;
+  size_t _pending        = 0;
+  double _poll_budget_ms = 2.0;
+};
+
+#endif
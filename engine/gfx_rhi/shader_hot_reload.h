@@ -0,0 +1,107 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef GFX_RHI_BASE_SHADER_HOT_RELOAD_H
+#define GFX_RHI_BASE_SHADER_HOT_RELOAD_H
+
+#include "gfx_rhi/shader.h"
+#include "gfx_rhi/shader_permutations.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+struct ShaderStageFile {
+  ShaderStage stage = ShaderStage_Vertex;
+  std::string path;
+};
+
+// Rebuilds the programs loaded through it when one of their files changes,
+// for iterating on shaders in the editor.
+//
+// A thread waits on inotify for files written in the watched directories,
+// reads the sources of every program that uses one of them, directly or
+// through an #include, and queues them. update() hands the queued sources
+// to ShaderCache::rebuild() on the rendering thread, where the driver
+// compiles them in the background and ShaderCache::poll() swaps each new
+// program in between frames. A program that fails keeps running its last
+// working version, the errors name the file and line they are in. Sources
+// loaded as permutations are handed to their ShaderPermutations, which
+// rebuilds every permutation it submitted so far.
+//
+// Only Linux has inotify, elsewhere programs load but are never reloaded.
+class ShaderHotReload {
+public:
+  ShaderHotReload(ShaderCache* cache);
+  ~ShaderHotReload();
+
+  // Watches the directory and the subdirectories it has at this point
+  bool watch(const std::string_view& directory);
+
+  // Reads the files with shader_load_source() and submits them to the cache,
+  // s_InvalidHandle when a file cannot be read
+  ShaderHandle load(const std::vector<ShaderStageFile>& files);
+  // Reads the files the same way for permutations of them, owned by the hot
+  // reload. Null when a file cannot be read
+  ShaderPermutations*
+      load_permutations(const std::vector<ShaderStageFile>& files,
+                        std::vector<std::string> features);
+
+  // Passes the programs reloaded since the last call to the cache, call once
+  // per frame before ShaderCache::poll(). Returns how many were passed
+  size_t update();
+
+private:
+  struct Program {
+    ShaderHandle handle              = ShaderCache::s_InvalidHandle;
+    ShaderPermutations* permutations = nullptr;  // In place of handle
+    std::vector<ShaderStageFile> files;
+    // Every file read while loading, absolute and sorted
+    std::vector<std::string> dependencies;
+  };
+
+  struct Reload {
+    ShaderHandle handle              = ShaderCache::s_InvalidHandle;
+    ShaderPermutations* permutations = nullptr;
+    std::vector<ShaderStageSource> stages;
+  };
+
+private:
+  static bool _load_sources(const std::vector<ShaderStageFile>& files,
+                            std::vector<ShaderStageSource>& stages);
+  void _add(Program program, const std::vector<ShaderStageSource>& stages);
+  void _run();
+  void _reload(std::vector<std::string>& changed);
+  static std::vector<std::string>
+      _dependencies(const std::vector<ShaderStageSource>& stages);
+
+private:
+  ShaderCache* _cache = nullptr;
+  int _inotify        = -1;
+  std::thread _thread;
+  std::atomic<bool> _running = false;
+
+  // Guards everything below, shared with the watching thread
+  std::mutex _mutex;
+  std::unordered_map<int, std::string> _directories;  // By watch descriptor
+  std::vector<Program> _programs;
+  std::vector<Reload> _reloads;
+
+  // Only used on the rendering thread
+  std::vector<std::unique_ptr<ShaderPermutations>> _permutations;
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef GFX_RHI_BASE_SHADER_PERMUTATIONS_H
+#define GFX_RHI_BASE_SHADER_PERMUTATIONS_H
+
+#include "gfx_rhi/shader.h"
+
+// Set of enabled features, bit N enables the N-th feature name given to
+// ShaderPermutations. Features are declared as plain enum flags so a key
+// spelled out at the draw site is folded into a constant, e.g.
+//
+//   enum MeshFeature {
+//     Mesh_SkinnedBit   = 1 << 0,
+//     Mesh_NormalMapBit = 1 << 1,
+//   };
+//   constexpr ShaderPermutationKey key =
+//       shader_permutation_key(Mesh_SkinnedBit, Mesh_NormalMapBit);
+using ShaderPermutationKey = uint32_t;
+
+template <typename... Bits>
+constexpr ShaderPermutationKey shader_permutation_key(Bits... bits) {
+  return (ShaderPermutationKey(0) | ... | (ShaderPermutationKey)bits);
+}
+
+// Every combination of a shader's features, each one built from the same
+// sources with a #define per enabled feature inserted after #version.
+//
+// Programs live in a table indexed by the key, so finding the program for a
+// draw is an index instead of building and hashing a name. A permutation is
+// only submitted to the cache the first time it is used, the keys used in a
+// session can be saved and passed to precompile() on the next start so they
+// are compiling before the first frame asks for them.
+class ShaderPermutations {
+public:
+  static constexpr uint32_t s_MaxFeatures = 12;
+
+public:
+  // - features: Define names, in key bit order
+  ShaderPermutations(ShaderCache* cache,
+                     std::vector<ShaderStageSource> stages,
+                     std::vector<std::string> features);
+
+  inline uint32_t feature_count() const { return (uint32_t)_features.size(); }
+  inline ShaderPermutationKey key_count() const {
+    return (ShaderPermutationKey)_handles.size();
+  }
+
+  // Submits the permutation on first use, s_InvalidHandle for keys with
+  // bits past the feature count
+  ShaderHandle handle(ShaderPermutationKey key);
+  // See ShaderCache::bind(), returns false when the draw has to be skipped
+  bool bind(ShaderPermutationKey key);
+
+  // Sources with the defines of the key inserted after the #version line
+  std::vector<ShaderStageSource> sources(ShaderPermutationKey key) const;
+  // Replaces the sources every permutation is built from, the ones submitted
+  // so far are passed to ShaderCache::rebuild(). Returns how many were
+  size_t reload(std::vector<ShaderStageSource> stages);
+
+  // Submits every key in the usage list, returns how many were valid keys
+  size_t precompile(const std::string_view& usage_path);
+  // Writes the keys used so far, one hexadecimal key per line
+  bool save_usage(const std::string_view& usage_path) const;
+
+private:
+  ShaderCache* _cache = nullptr;
+  std::vector<ShaderStageSource> _stages;
+  std::vector<std::string> _features;
+  std::vector<ShaderHandle> _handles;  // Indexed by key
+};
+
+#endif
@@ -0,0 +1,306 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef GFX_RHI_BASE_SHADER_REFLECTION_H
+#define GFX_RHI_BASE_SHADER_REFLECTION_H
+
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ShaderProgram;
+class ShaderCache;
+class FrameRingBuffer;
+
+enum ShaderDataType {
+  ShaderDataType_Float,
+  ShaderDataType_Vec2,
+  ShaderDataType_Vec3,
+  ShaderDataType_Vec4,
+  ShaderDataType_Int,
+  ShaderDataType_IVec2,
+  ShaderDataType_IVec3,
+  ShaderDataType_IVec4,
+  ShaderDataType_UInt,
+  ShaderDataType_UVec2,
+  ShaderDataType_UVec3,
+  ShaderDataType_UVec4,
+  ShaderDataType_Bool,
+  ShaderDataType_Mat2,
+  ShaderDataType_Mat3,
+  ShaderDataType_Mat4,
+  ShaderDataType_Sampler,  // Samplers and images, set as an int unit
+  ShaderDataType_Other,
+};
+
+std::string_view shader_data_type_to_string(ShaderDataType type);
+
+// C++ type a handle of ShaderDataType is set with, matrices are written a
+// column at a time so the block's matrix stride can be applied
+template <typename T>
+struct ShaderDataTypeOf;
+
+#define SHADER_DATA_TYPE_OF(_type, _data_type, _columns)                       \
+  template <>                                                                  \
+  struct ShaderDataTypeOf<_type> {                                             \
+    static constexpr ShaderDataType type = _data_type;                         \
+    static constexpr uint32_t columns    = _columns;                           \
+  }
+
+SHADER_DATA_TYPE_OF(float, ShaderDataType_Float, 1);
+SHADER_DATA_TYPE_OF(glm::vec2, ShaderDataType_Vec2, 1);
+SHADER_DATA_TYPE_OF(glm::vec3, ShaderDataType_Vec3, 1);
+SHADER_DATA_TYPE_OF(glm::vec4, ShaderDataType_Vec4, 1);
+SHADER_DATA_TYPE_OF(int32_t, ShaderDataType_Int, 1);
+SHADER_DATA_TYPE_OF(glm::ivec2, ShaderDataType_IVec2, 1);
+SHADER_DATA_TYPE_OF(glm::ivec3, ShaderDataType_IVec3, 1);
+SHADER_DATA_TYPE_OF(glm::ivec4, ShaderDataType_IVec4, 1);
+SHADER_DATA_TYPE_OF(uint32_t, ShaderDataType_UInt, 1);
+SHADER_DATA_TYPE_OF(glm::uvec2, ShaderDataType_UVec2, 1);
+SHADER_DATA_TYPE_OF(glm::uvec3, ShaderDataType_UVec3, 1);
+SHADER_DATA_TYPE_OF(glm::uvec4, ShaderDataType_UVec4, 1);
+SHADER_DATA_TYPE_OF(glm::mat2, ShaderDataType_Mat2, 2);
+SHADER_DATA_TYPE_OF(glm::mat3, ShaderDataType_Mat3, 3);
+SHADER_DATA_TYPE_OF(glm::mat4, ShaderDataType_Mat4, 4);
+
+#undef SHADER_DATA_TYPE_OF
+
+// Whether a handle of type `type` can set a variable of type `variable`,
+// bools and samplers are set through ints
+constexpr bool shader_data_type_compatible(ShaderDataType type,
+                                           ShaderDataType variable) {
+  return type == variable ||
+         (type == ShaderDataType_Int && (variable == ShaderDataType_Bool ||
+                                         variable == ShaderDataType_Sampler));
+}
+
+struct ShaderVariable {
+  // As reported by the driver, arrays end in [0] and block members may be
+  // prefixed with the block name
+  std::string name;
+  ShaderDataType type = ShaderDataType_Other;
+  int32_t location    = -1;  // Uniforms outside of blocks only
+  uint32_t array_size = 1;
+
+  // Block members only, bytes from the start of the block
+  uint32_t offset        = 0;
+  uint32_t array_stride  = 0;
+  uint32_t matrix_stride = 0;
+};
+
+enum ShaderBlockKind {
+  ShaderBlockKind_Uniform,  // std140 unless declared otherwise
+  ShaderBlockKind_Storage,  // std430 unless declared otherwise
+};
+
+struct ShaderBlock {
+  std::string name;
+  ShaderBlockKind kind = ShaderBlockKind_Uniform;
+  uint32_t binding     = 0;
+  uint32_t size        = 0;
+  std::vector<ShaderVariable> members;
+
+  // Matches the name with or without the block prefix and array suffix
+  const ShaderVariable* find_member(const std::string_view& name) const;
+};
+
+// Active uniforms and blocks of a linked program, gathered once after it
+// links so nothing has to be queried from the driver while drawing
+struct ShaderReflection {
+  std::vector<ShaderVariable> uniforms;
+  std::vector<ShaderBlock> blocks;
+
+  // Matches the name with or without the array suffix
+  const ShaderVariable* find_uniform(const std::string_view& name) const;
+  const ShaderBlock* find_block(const std::string_view& name) const;
+
+  static ShaderReflection reflect(uint32_t program);
+};
+
+// Uniform outside of blocks, the location is resolved once so setting it is
+// a single call.
+//
+// A uniform resolved against a ShaderCache entry follows the entry's program,
+// it is resolved again the first time it is set after the cache swapped in a
+// rebuilt program, as the new program may lay out its uniforms differently.
+// One resolved against a ShaderProgram is tied to that program
+template <typename T>
+class ShaderUniform {
+public:
+  ShaderUniform() = default;
+  ShaderUniform(const ShaderProgram& program, const std::string_view& name);
+  // - handle: ShaderHandle of the entry, may still be pending
+  ShaderUniform(const ShaderCache& cache, uint32_t handle,
+                const std::string_view& name);
+
+  // As of the last resolve
+  inline bool valid() const { return _location != -1; }
+  inline uint32_t count() const { return _count; }
+
+  inline void set(const T& value) { set(&value, 1); }
+  // Sets the first count elements of an array, clamped to its size
+  void set(const T* values, uint32_t count);
+
+private:
+  uint32_t _program = 0;
+  int32_t _location = -1;
+  uint32_t _count   = 0;
+
+  const ShaderCache* _cache = nullptr;
+  uint32_t _entry           = 0;
+  uint32_t _generation      = UINT32_MAX;  // ShaderCache::generation
+  std::string _name;
+};
+
+// Resolves a ShaderUniform, logs why it cannot and returns false
+bool shader_resolve_uniform(const ShaderProgram& program,
+                            const std::string_view& name, ShaderDataType type,
+                            uint32_t& handle, int32_t& location,
+                            uint32_t& count);
+// Resolves a ShaderUniform again when the cache entry's program changed since
+// generation, location is -1 while the entry has no program
+void shader_refresh_uniform(const ShaderCache& cache, uint32_t entry,
+                            const std::string_view& name, ShaderDataType type,
+                            uint32_t& generation, uint32_t& handle,
+                            int32_t& location, uint32_t& count);
+
+template <typename T>
+ShaderUniform<T>::ShaderUniform(const ShaderProgram& program,
+                                const std::string_view& name) {
+  if (!shader_resolve_uniform(program, name, ShaderDataTypeOf<T>::type,
+                              _program, _location, _count)) {
+    _location = -1;
+  }
+}
+
+template <typename T>
+ShaderUniform<T>::ShaderUniform(const ShaderCache& cache, uint32_t handle,
+                                const std::string_view& name)
+    : _cache(&cache), _entry(handle), _name(name) {
+  shader_refresh_uniform(cache, handle, _name, ShaderDataTypeOf<T>::type,
+                         _generation, _program, _location, _count);
+}
+
+// Instantiated for every ShaderDataTypeOf type next to the GL calls
+extern template class ShaderUniform<float>;
+extern template class ShaderUniform<glm::vec2>;
+extern template class ShaderUniform<glm::vec3>;
+extern template class ShaderUniform<glm::vec4>;
+extern template class ShaderUniform<int32_t>;
+extern template class ShaderUniform<glm::ivec2>;
+extern template class ShaderUniform<glm::ivec3>;
+extern template class ShaderUniform<glm::ivec4>;
+extern template class ShaderUniform<uint32_t>;
+extern template class ShaderUniform<glm::uvec2>;
+extern template class ShaderUniform<glm::uvec3>;
+extern template class ShaderUniform<glm::uvec4>;
+extern template class ShaderUniform<glm::mat2>;
+extern template class ShaderUniform<glm::mat3>;
+extern template class ShaderUniform<glm::mat4>;
+
+// Member of a ShaderBlockData, the offset and strides from the reflected
+// layout are resolved once. Setting a field that does not fit the block it
+// is set on does nothing
+template <typename T>
+class ShaderBlockField {
+public:
+  inline bool valid() const { return _offset != UINT32_MAX; }
+  inline uint32_t count() const { return _count; }
+
+private:
+  friend class ShaderBlockData;
+
+  uint32_t _offset        = UINT32_MAX;
+  uint32_t _array_stride  = 0;
+  uint32_t _matrix_stride = 0;
+  uint32_t _count         = 0;
+};
+
+// CPU copy of a uniform or storage block, such as a material's parameters.
+//
+// Fields are written at the offsets the driver reported, so std140 and
+// std430 padding never has to be mirrored by a C++ struct. upload() copies
+// the whole block into a FrameRingBuffer allocation with one memcpy and
+// binds that range to the block's binding point.
+class ShaderBlockData {
+public:
+  ShaderBlockData() = default;
+  ShaderBlockData(const ShaderBlock& block);
+
+  inline const ShaderBlock& block() const { return _block; }
+  inline const uint8_t* data() const { return _data.data(); }
+  inline size_t size() const { return _data.size(); }
+
+  template <typename T>
+  ShaderBlockField<T> field(const std::string_view& name) const;
+
+  template <typename T>
+  void set(const ShaderBlockField<T>& field, const T& value,
+           uint32_t index = 0);
+
+  // Returns false when the ring buffer has no room left this frame
+  bool upload(FrameRingBuffer& ring) const;
+
+private:
+  // Logs why the member cannot be used and returns null
+  const ShaderVariable* _resolve(const std::string_view& name,
+                                 ShaderDataType type) const;
+
+private:
+  ShaderBlock _block;
+  std::vector<uint8_t> _data;
+};
+
+template <typename T>
+ShaderBlockField<T> ShaderBlockData::field(const std::string_view& name) const {
+  ShaderBlockField<T> field;
+  const ShaderVariable* member = _resolve(name, ShaderDataTypeOf<T>::type);
+  if (member != nullptr) {
+    field._offset        = member->offset;
+    field._array_stride  = member->array_stride;
+    field._matrix_stride = member->matrix_stride;
+    field._count         = member->array_size;
+  }
+  return field;
+}
+
+template <typename T>
+void ShaderBlockData::set(const ShaderBlockField<T>& field, const T& value,
+                          uint32_t index) {
+  // A field resolved against another block, or against the layout before
+  // the program was rebuilt, may point past the end of this one
+  constexpr uint32_t columns = ShaderDataTypeOf<T>::columns;
+  const size_t offset =
+      (size_t)field._offset + (size_t)index * field._array_stride;
+  const size_t end = offset + (size_t)(columns - 1) * field._matrix_stride +
+                     sizeof(T) / columns;
+  if (index >= field._count || end > _data.size()) {
+    return;
+  }
+  uint8_t* at = _data.data() + offset;
+  if constexpr (columns > 1) {
+    for (uint32_t column = 0; column < columns; column++) {
+      std::memcpy(at + column * field._matrix_stride, &value[column],
+                  sizeof(value[column]));
+    }
+  } else {
+    std::memcpy(at, &value, sizeof(T));
+  }
+}
+
+#endif
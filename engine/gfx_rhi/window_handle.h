@@ -15,6 +15,7 @@
 #ifndef GFX_RHI_BASE_WINDOW_HANDLE_H
 #define GFX_RHI_BASE_WINDOW_HANDLE_H
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string_view>
 
@@ -29,6 +30,13 @@ enum WindowHandleFlags {
   WindowHandle_TrippleBufferBit     = 1 << 4,
   WindowHandle_ResizableBit         = 1 << 5,
   WindowHandle_TransparentBufferBit = 1 << 6,
+  // Invisible window on GLFW's null platform, for machines without a
+  // display. Uses a software context (OSMesa or surfaceless EGL) when one is
+  // installed, otherwise the window has no context, see has_context()
+  WindowHandle_HeadlessBit = 1 << 7,
+  // With VsyncBit, a late frame is presented right away instead of waiting
+  // for the next vblank, when the driver supports tearing swap control
+  WindowHandle_AdaptiveVsyncBit = 1 << 8,
 };
 
 class WindowHandle {
@@ -51,8 +59,16 @@ public:
 
   void destroy();
   void swap_buffers();
+  // Steady clock time in nanoseconds (the clock of input_time_ns) of the
+  // last swap_buffers call, taken before the swap can block
+  inline uint64_t last_swap_ns() const { return _last_swap_ns; }
   bool closing() const;
   void make_current_context();
+  // Updates VsyncBit and AdaptiveVsyncBit and the swap interval
+  void set_vsync(bool enabled, bool adaptive = false);
+  // False for a headless window without a rendering context, nothing can be
+  // rendered and swap_buffers only marks the end of the frame
+  inline bool has_context() const { return _has_context; }
 
   inline int& options() { return _opts; }
   inline int options() const { return _opts; }
@@ -60,10 +76,14 @@ public:
 private:
   virtual bool _initialize(const std::string_view& title, int32_t width,
                            int32_t height, int flags = s_DefaultOptions);
+  GLFWwindow* _create_headless_window(int32_t width, int32_t height,
+                                      const char* title);
   static bool _valid_options(int opts);
 
-  GLFWwindow* _win_ptr = nullptr;
-  int _opts            = WindowHandle::s_DefaultOptions;
+  GLFWwindow* _win_ptr   = nullptr;
+  int _opts              = WindowHandle::s_DefaultOptions;
+  bool _has_context      = false;
+  uint64_t _last_swap_ns = 0;
 };
 
 #endif
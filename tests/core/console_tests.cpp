@@ -0,0 +1,197 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "core/console.h"
+#include "test.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+class CaptureOutput : public ConsoleOutput {
+public:
+  CaptureOutput(std::vector<uint32_t>* repeats)
+      : ConsoleOutput(ConsoleOutput::s_SeverityMask |
+                      ConsoleOutput_CoalesceBit),
+        _repeats(repeats) {}
+
+  inline std::string_view name() const override { return "Capture Output"; }
+  void print_output(const ConsoleMessage& msg) override {
+    _repeats->push_back(msg.repeats);
+  }
+
+private:
+  std::vector<uint32_t>* _repeats = nullptr;
+};
+
+}  // namespace
+
+TEST_CASE(console_flush_reports_trailing_repeats) {
+  // Repeat count of every printed message, 0 for a regular message
+  std::vector<uint32_t> repeats;
+  Console console;
+  console.add_output(new CaptureOutput(&repeats));
+
+  for (int i = 0; i < 5; i++) {
+    CONTEXT_INFO("TESTS", "Same message");
+  }
+  TEST_CHECK(repeats.size() == 1);
+
+  // Nothing else is printed, flushing still has to report the run
+  console.flush();
+  TEST_CHECK(repeats.size() == 2 && repeats[1] == 4);
+  console.destroy();
+}
+
+namespace {
+
+// Logs a message of its own for every message it receives from elsewhere,
+// and flushes the console from inside the output
+class EchoOutput : public ConsoleOutput {
+public:
+  EchoOutput(Console* console, size_t* received)
+      : ConsoleOutput(ConsoleOutput::s_SeverityMask), _console(console),
+        _received(received) {}
+
+  inline std::string_view name() const override { return "Echo Output"; }
+  void print_output(const ConsoleMessage& msg) override {
+    (*_received)++;
+    if (msg.msg != "Echo") {
+      CONTEXT_INFO("TESTS", "Echo");
+      _console->flush();
+    }
+  }
+
+private:
+  Console* _console = nullptr;
+  size_t* _received = nullptr;
+};
+
+}  // namespace
+
+TEST_CASE(console_block_overflow_logging_from_output) {
+  // Only touched by the writer thread until flush returns
+  size_t received = 0;
+  Console console(Console_AsyncBit | Console_OverflowBlockBit, 2);
+  console.add_output(new EchoOutput(&console, &received));
+
+  // The queue is full most of the time, an echo blocking on it would never
+  // be taken off by the writer it blocks
+  for (int i = 0; i < 32; i++) {
+    CONTEXT_INFO("TESTS", "Message {}", i);
+  }
+  console.flush();
+  TEST_CHECK(received == 64);
+  console.destroy();
+}
+
+namespace {
+
+class SuppressedOutput : public ConsoleOutput {
+public:
+  SuppressedOutput(std::vector<uint32_t>* suppressed)
+      : ConsoleOutput(ConsoleOutput::s_SeverityMask),
+        _suppressed(suppressed) {}
+
+  inline std::string_view name() const override {
+    return "Suppressed Output";
+  }
+  void print_output(const ConsoleMessage& msg) override {
+    _suppressed->push_back(msg.suppressed);
+  }
+
+private:
+  std::vector<uint32_t>* _suppressed = nullptr;
+};
+
+}  // namespace
+
+TEST_CASE(console_reports_rate_limited_burst_that_stopped) {
+  // Suppressed count of every printed message, 0 for a regular message
+  std::vector<uint32_t> suppressed;
+  Console console;
+  ConsoleOutput* output = new SuppressedOutput(&suppressed);
+  output->set_rate_limit(2);
+  console.add_output(output);
+
+  for (int i = 0; i < 5; i++) {
+    CONTEXT_INFO("TESTS", "Burst {}", i);
+  }
+  TEST_CHECK(suppressed.size() == 2);
+
+  // The window is still open, the site may print again within it
+  console.flush_expired_repeats();
+  TEST_CHECK(suppressed.size() == 2);
+
+  // The site never prints again, destroying still has to report the burst
+  console.destroy();
+  TEST_CHECK(suppressed.size() == 3 && suppressed[2] == 3);
+}
+
+namespace {
+
+struct TestHex {
+  int value = 0;
+};
+
+class TextOutput : public ConsoleOutput {
+public:
+  TextOutput(std::vector<std::string>* texts)
+      : ConsoleOutput(ConsoleOutput::s_SeverityMask), _texts(texts) {}
+
+  inline std::string_view name() const override { return "Text Output"; }
+  void print_output(const ConsoleMessage& msg) override {
+    _texts->emplace_back(msg.msg);
+  }
+
+private:
+  std::vector<std::string>* _texts = nullptr;
+};
+
+// The condition macros return from the function they are in
+void print_failed_condition() {
+  CONTEXT_CONDITION_ERROR("TESTS", 1 + 1 == 3, "{}", "condition");
+}
+
+}  // namespace
+
+template <>
+struct fmt::formatter<TestHex> : fmt::formatter<int> {
+  auto format(TestHex hex, fmt::format_context& ctx) const {
+    return fmt::formatter<int>::format(hex.value, ctx);
+  }
+};
+
+TEST_CASE(console_async_writer_formats_text) {
+  std::vector<std::string> texts;
+  Console console(Console_AsyncBit);
+  console.add_output(new TextOutput(&texts));
+
+  std::string temporary = "gone";
+  CONTEXT_INFO("TESTS", "{} {:.2f} {:>6} {}", 42, 1.5, temporary, true);
+  temporary.clear();
+  // Only the formatter knows the type, the spec would not apply to its text
+  CONTEXT_INFO("TESTS", "{:x}", TestHex {255});
+  print_failed_condition();
+  console.flush();
+
+  TEST_CHECK(texts.size() == 3);
+  TEST_CHECK(texts.size() > 0 && texts[0] == "42 1.50   gone true");
+  TEST_CHECK(texts.size() > 1 && texts[1] == "ff");
+  TEST_CHECK(texts.size() > 2 &&
+             texts[2] == "`1 + 1 == 3` == FALSE: condition");
+  console.destroy();
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input_actions.h"
+#include "test.h"
+
+TEST_CASE(input_actions_invalid_binding_keeps_other_actions) {
+  InputActionMap map;
+  InputAction jump  = map.add_action("jump");
+  InputAction fire  = map.add_action("fire");
+  InputAction crawl = map.add_action("crawl");
+  map.bind(jump, InputBinding::key(KeyCode_Space));
+  map.bind(fire, InputBinding::mouse(MouseButton_Left));
+  map.bind(crawl, InputBinding::key(KeyCode_C));
+
+  // Rebinding fire to an out of range key has to leave jump and crawl alone
+  map.set_bindings(fire, {InputBinding::key((KeyCode)(KeyCode_Last + 100))});
+  map.bind(crawl, InputBinding::key(KeyCode_LeftControl));
+
+  InputKeyBits keys;
+  keys.set(KeyCode_Space);
+  keys.set(KeyCode_LeftControl);
+  InputMouseBits mouse;
+  mouse.set(MouseButton_Left);
+  map.update(keys, mouse, InputGamepadButtonBits(), 0);
+
+  TEST_CHECK(map.pressed(jump));
+  TEST_CHECK(map.down(crawl));
+  TEST_CHECK(!map.down(fire));
+  TEST_CHECK(map.bindings(fire).size() == 1);
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "core/input_latency.h"
+#include "test.h"
+
+TEST_CASE(input_latency_window_empties_without_samples) {
+  InputLatency latency(100);
+  const uint64_t ms = 1000000;
+  latency.record(5 * ms, 1 * ms);
+  latency.record(7 * ms, 50 * ms);
+  TEST_CHECK(latency.summary().count == 2);
+
+  // Frames keep going after input stopped, within the window the samples
+  // are still reported
+  latency.advance(400 * ms);
+  TEST_CHECK(latency.summary().count == 2);
+
+  // Once every slice has moved on the window is empty
+  latency.advance(1 * ms + InputLatency::s_Slices * 100 * ms);
+  TEST_CHECK(latency.summary().count == 0);
+  TEST_CHECK(latency.summary().max_ms == 0.0);
+}
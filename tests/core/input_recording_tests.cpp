@@ -0,0 +1,76 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/input.h"
+#include "test.h"
+#include <cstdio>
+
+// A session as Input records it: a left stick sweep and trigger pull on the
+// first gamepad, plus cursor moves and scrolling
+TEST_CASE(input_replay_applies_axis_cursor_and_scroll) {
+  const char* path      = "fiwre_test_input_replay.bin";
+  const float stick[]   = {0.0f, 0.4f, 0.9f, -0.7f, 0.0f};
+  const float trigger[] = {-1.0f, -0.2f, 1.0f, 1.0f, -1.0f};
+  const uint32_t frames = 5;
+
+  InputRecorder recorder(path);
+  TEST_CHECK(recorder.valid());
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    recorder.record(InputRecordEvent::make_value(
+        input_time_ns(), frame, InputRecordType_GamepadAxis,
+        GamepadAxis_LeftX, stick[frame], 0.0f));
+    recorder.record(InputRecordEvent::make_value(
+        input_time_ns(), frame, InputRecordType_GamepadAxis,
+        GamepadAxis_RightTrigger, trigger[frame], 0.0f));
+    recorder.record(InputRecordEvent::make_value(
+        input_time_ns(), frame, InputRecordType_CursorPos, 0,
+        10.0f * (float)frame, 5.0f));
+    recorder.record(InputRecordEvent::make_value(
+        input_time_ns(), frame, InputRecordType_Scroll, 0, 0.0f, 1.0f));
+  }
+  recorder.finish(frames - 1);
+
+  // The same session applied live, with smoothing so every frame's value
+  // depends on all the ones before it
+  InputGamepads live;
+  live.config().smoothing = 0.5f;
+
+  WindowHandle window("fiwre_tests", 64, 64, WindowHandle_HeadlessBit);
+  {
+    Input input(&window);
+    Input::gamepad_config().smoothing = 0.5f;
+    TEST_CHECK(input.start_replay(path));
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      input.poll_events();
+      live.set_axis(0, GamepadAxis_LeftX, stick[frame]);
+      live.set_axis(0, GamepadAxis_RightTrigger, trigger[frame]);
+      live.process();
+
+      TEST_CHECK(Input::gamepad_axis(GamepadJoystick_1, GamepadAxis_LeftX) ==
+                 live.axis(GamepadJoystick_1, GamepadAxis_LeftX));
+      TEST_CHECK(Input::gamepad_axis(GamepadJoystick_1,
+                                     GamepadAxis_RightTrigger) ==
+                 live.axis(GamepadJoystick_1, GamepadAxis_RightTrigger));
+      TEST_CHECK(Input::mouse_position() ==
+                 glm::vec2(10.0f * (float)frame, 5.0f));
+      TEST_CHECK(Input::mouse_scroll() == glm::vec2(0.0f, 1.0f));
+    }
+    TEST_CHECK(live.axis(GamepadJoystick_1, GamepadAxis_LeftX) != 0.0f);
+    TEST_CHECK(input.replay_finished());
+  }
+  window.destroy();
+  std::remove(path);
+}
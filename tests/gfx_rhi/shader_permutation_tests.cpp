@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "gfx_rhi/shader_permutations.h"
+#include "test.h"
+#include <cstdio>
+
+TEST_CASE(shader_permutations_defines_follow_version_line) {
+  ShaderStageSource stage;
+  stage.source = "// Header comment\n"
+                 "\n"
+                 "  #  version 450 core\n"
+                 "void main() {}\n";
+  ShaderPermutations permutations(nullptr, {stage}, {"SHADOWS", "FOG"});
+
+  std::string source = permutations.sources(0x2)[0].source;
+  TEST_CHECK(source == "// Header comment\n"
+                       "\n"
+                       "  #  version 450 core\n"
+                       "#define FOG 1\n"
+                       "#line 4\n"
+                       "void main() {}\n");
+
+  // Without a #version the defines go first
+  stage.source = "void main() {}\n";
+  ShaderPermutations unversioned(nullptr, {stage}, {"SHADOWS"});
+  TEST_CHECK(unversioned.sources(0x1)[0].source ==
+             "#define SHADOWS 1\n#line 1\nvoid main() {}\n");
+}
+
+TEST_CASE(shader_permutations_precompile_skips_invalid_keys) {
+  const char* path = "fiwre_test_shader_usage.txt";
+  FILE* file       = std::fopen(path, "w");
+  std::fprintf(file, "4\nff\n");
+  std::fclose(file);
+
+  // Two features only have the keys 0 to 3
+  ShaderStageSource stage;
+  ShaderPermutations permutations(nullptr, {stage}, {"SHADOWS", "FOG"});
+  TEST_CHECK(permutations.precompile(path) == 0);
+  std::remove(path);
+}
+
+TEST_CASE(shader_permutations_reload_replaces_sources) {
+  ShaderStageSource stage;
+  stage.source = "#version 450 core\nvoid main() {}\n";
+  ShaderPermutations permutations(nullptr, {stage}, {"SHADOWS"});
+
+  // Nothing was submitted, so nothing is passed to the cache
+  stage.source = "#version 450 core\nvoid main() { discard; }\n";
+  TEST_CHECK(permutations.reload({stage}) == 0);
+  TEST_CHECK(permutations.sources(0x1)[0].source ==
+             "#version 450 core\n#define SHADOWS 1\n#line 2\n"
+             "void main() { discard; }\n");
+}
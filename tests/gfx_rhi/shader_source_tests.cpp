@@ -0,0 +1,86 @@
+// Copyright (c) 2024 Oniup (https://github.com/Oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "gfx_rhi/shader.h"
+#include "test.h"
+#include <cstdio>
+#include <filesystem>
+
+static void _write_file(const std::string& path, const char* text) {
+  FILE* file = std::fopen(path.c_str(), "w");
+  std::fputs(text, file);
+  std::fclose(file);
+}
+
+TEST_CASE(shader_load_source_expands_includes_once) {
+  namespace fs          = std::filesystem;
+  const std::string dir = "fiwre_test_shaders";
+  fs::create_directories(dir + "/lib");
+  _write_file(dir + "/main.frag", "#version 450 core\n"
+                                  "#include \"lib/common.glsl\"\n"
+                                  "  #  include <lib/common.glsl>\n"
+                                  "void main() {}\n");
+  _write_file(dir + "/lib/common.glsl", "#include \"math.glsl\"\n"
+                                        "float f() { return pi(); }\n");
+  _write_file(dir + "/lib/math.glsl", "float pi() { return 3.14; }\n");
+
+  ShaderStageSource stage;
+  TEST_CHECK(shader_load_source(dir + "/main.frag", ShaderStage_Fragment,
+                                stage));
+  TEST_CHECK(stage.stage == ShaderStage_Fragment);
+  TEST_CHECK(stage.files.size() == 3);
+  TEST_CHECK(stage.files[0] == dir + "/main.frag");
+  TEST_CHECK(stage.files[1] == dir + "/lib/common.glsl");
+  TEST_CHECK(stage.files[2] == dir + "/lib/math.glsl");
+
+  // Each file is numbered by its index in files, the second include of the
+  // same file becomes a blank line so the including file's lines still match
+  TEST_CHECK(stage.source == "#version 450 core\n"
+                             "#line 1 1\n"
+                             "#line 1 2\n"
+                             "float pi() { return 3.14; }\n"
+                             "#line 2 1\n"
+                             "float f() { return pi(); }\n"
+                             "#line 3 0\n"
+                             "\n"
+                             "void main() {}\n");
+
+  // A missing include fails the whole stage
+  _write_file(dir + "/broken.frag", "#include \"missing.glsl\"\n");
+  TEST_CHECK(!shader_load_source(dir + "/broken.frag", ShaderStage_Fragment,
+                                 stage));
+  fs::remove_all(dir);
+}
+
+TEST_CASE(shader_map_log_names_source_files) {
+  const std::vector<std::string> files = {"main.frag", "common.glsl"};
+
+  // Mesa
+  TEST_CHECK(shader_map_log("1:12(4): error: `x' undeclared\n", files) ==
+             "common.glsl:12(4): error: `x' undeclared\n");
+  // AMD
+  TEST_CHECK(shader_map_log("ERROR: 0:7: 'y' : undeclared identifier\n",
+                            files) ==
+             "ERROR: main.frag:7: 'y' : undeclared identifier\n");
+  // NVIDIA
+  TEST_CHECK(shader_map_log("1(3) : error C1008: undefined variable \"z\"",
+                            files) ==
+             "common.glsl:3 : error C1008: undefined variable \"z\"");
+
+  // Lines without a known source string are left alone
+  const char* other = "5:1(1): error: out of range\nlinker error\n";
+  TEST_CHECK(shader_map_log(other, files) == other);
+  TEST_CHECK(shader_map_log("0:1(1): error\n", {}) == "0:1(1): error\n");
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "test.h"
+#include <cstring>
+#include <fmt/format.h>
+
+static size_t s_failed_checks = 0;
+
+std::vector<TestCase>& test_registry() {
+  static std::vector<TestCase> registry;
+  return registry;
+}
+
+bool test_register(const char* name, void (*func)()) {
+  test_registry().push_back(TestCase {.name = name, .func = func});
+  return true;
+}
+
+void test_check(bool passed, const char* expression, const char* file,
+                int line) {
+  if (!passed) {
+    fmt::println(stderr, "  {}:{}: check failed: {}", file, line, expression);
+    s_failed_checks++;
+  }
+}
+
+// Runs every test, or the ones whose name contains the first argument
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : "";
+  size_t failed      = 0;
+  size_t ran         = 0;
+  for (const TestCase& test : test_registry()) {
+    if (std::strstr(test.name, filter) == nullptr) {
+      continue;
+    }
+    size_t checks = s_failed_checks;
+    test.func();
+    ran++;
+    bool passed = checks == s_failed_checks;
+    failed += passed ? 0 : 1;
+    fmt::println("{} {}", passed ? "[PASS]" : "[FAIL]", test.name);
+  }
+  fmt::println("{} of {} tests passed", ran - failed, ran);
+  return failed == 0 ? 0 : 1;
+}
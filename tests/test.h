@@ -0,0 +1,41 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include <cstddef>
+#include <vector>
+
+struct TestCase {
+  const char* name = nullptr;
+  void (*func)()    = nullptr;
+};
+
+std::vector<TestCase>& test_registry();
+bool test_register(const char* name, void (*func)());
+// Records a failed check of the running test, execution carries on
+void test_check(bool passed, const char* expression, const char* file,
+                int line);
+
+#define TEST_CASE(_name)                                                       \
+  static void _name();                                                         \
+  static const bool _name##_registered = test_register(#_name, _name);         \
+  static void _name()
+
+#define TEST_CHECK(_condition)                                                 \
+  test_check((_condition), #_condition, __FILE__, __LINE__)
+
+#endif
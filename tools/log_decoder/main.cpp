@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Oniup (https://github.com/oniup)
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/console.h"
+#include "core/console_binary.h"
+#include <cstdio>
+#include <cstring>
+
+// Prints decoded messages to stdout exactly as ConsoleTerminalOutput would
+// have formatted them
+class DecoderOutput : public ConsoleOutput {
+public:
+  DecoderOutput(int opts)
+        : ConsoleOutput(opts) {}
+
+  inline std::string_view name() const override { return "Decoder Output"; }
+  void print_output(const ConsoleMessage& msg) override {
+    std::string_view text = _format(msg);
+    std::fwrite(text.data(), 1, text.size(), stdout);
+  }
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fmt::println(stderr, "usage: {} <stream> [--no-color]", argv[0]);
+    return 1;
+  }
+
+  Console console;
+  console.add_output<ConsoleTerminalOutput>();
+
+  ConsoleBinaryReader reader(argv[1]);
+  if (!reader.valid()) {
+    console.destroy();
+    return 1;
+  }
+
+  int opts = reader.opts();
+  if (argc > 2 && std::strcmp(argv[2], "--no-color") == 0) {
+    opts &= ~ConsoleOutput_ColorBit;
+  }
+  DecoderOutput output(opts);
+
+  ConsoleMessage msg;
+  while (reader.next(msg)) {
+    output.print_output(msg);
+  }
+
+  console.destroy();
+  return 0;
+}